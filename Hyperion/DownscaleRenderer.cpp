@@ -0,0 +1,108 @@
+#include "DownscaleRenderer.hpp"
+#include "DownscaleShader.hpp"
+
+#include <Gfx/Graph/Utils.hpp>
+
+namespace Hyperion
+{
+DownscaleRenderer::DownscaleRenderer(
+    const score::gfx::OutputNode& node, score::gfx::TextureRenderTarget rt,
+    QRhiReadbackResult& readback)
+    : score::gfx::OutputNodeRenderer{node}
+    , m_renderTarget{rt}
+    , m_readback{&readback}
+{
+}
+
+DownscaleRenderer::~DownscaleRenderer() { }
+
+score::gfx::TextureRenderTarget
+DownscaleRenderer::renderTargetForInput(const score::gfx::Port&)
+{
+  return m_inputTarget;
+}
+
+void DownscaleRenderer::init(
+    score::gfx::RenderList& renderer, QRhiResourceUpdateBatch& res)
+{
+  auto& rhi = *renderer.state.rhi;
+  const QSize srcSize = renderer.state.renderSize;
+  const QSize dstSize = m_renderTarget.texture->pixelSize();
+
+  m_inputTarget = score::gfx::createRenderTarget(
+      renderer.state, QRhiTexture::RGBA8, srcSize, renderer.samples());
+
+  auto [vertexS, fragmentS]
+      = score::gfx::makeShaders(
+          renderer.state, downscaleVertexShader, downscaleFragmentShader);
+
+  m_ubo = rhi.newBuffer(
+      QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(DownscaleParams));
+  m_ubo->create();
+
+  m_sampler = rhi.newSampler(
+      QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+  m_sampler->create();
+
+  m_srb = rhi.newShaderResourceBindings();
+  m_srb->setBindings(
+      {QRhiShaderResourceBinding::uniformBuffer(
+           0, QRhiShaderResourceBinding::FragmentStage, m_ubo),
+       QRhiShaderResourceBinding::sampledTexture(
+           1, QRhiShaderResourceBinding::FragmentStage, m_inputTarget.texture,
+           m_sampler)});
+  m_srb->create();
+
+  m_pipeline = rhi.newGraphicsPipeline();
+  m_pipeline->setShaderStages(
+      {{QRhiShaderStage::Vertex, vertexS}, {QRhiShaderStage::Fragment, fragmentS}});
+  m_pipeline->setVertexInputLayout({});
+  m_pipeline->setShaderResourceBindings(m_srb);
+  m_pipeline->setRenderPassDescriptor(m_renderTarget.renderPass);
+  m_pipeline->create();
+
+  const auto params = DownscaleParams::make(
+      srcSize.width(), srcSize.height(), dstSize.width(), dstSize.height(),
+      rhi.isYUpInFramebuffer());
+  res.updateDynamicBuffer(m_ubo, 0, sizeof(params), &params);
+}
+
+void DownscaleRenderer::update(
+    score::gfx::RenderList&, QRhiResourceUpdateBatch&, score::gfx::Edge*)
+{
+}
+
+void DownscaleRenderer::release(score::gfx::RenderList&)
+{
+  delete m_pipeline;
+  m_pipeline = nullptr;
+  delete m_srb;
+  m_srb = nullptr;
+  delete m_sampler;
+  m_sampler = nullptr;
+  delete m_ubo;
+  m_ubo = nullptr;
+  m_inputTarget.release();
+}
+
+void DownscaleRenderer::finishFrame(
+    score::gfx::RenderList& renderer, QRhiCommandBuffer& cb,
+    QRhiResourceUpdateBatch*& res)
+{
+  const QSize dstSize = m_renderTarget.texture->pixelSize();
+
+  cb.beginPass(m_renderTarget.renderTarget, Qt::black, {1.0f, 0}, res);
+  res = nullptr;
+  {
+    cb.setGraphicsPipeline(m_pipeline);
+    cb.setShaderResources(m_srb);
+    cb.setViewport(QRhiViewport(0, 0, dstSize.width(), dstSize.height()));
+    cb.draw(3);
+  }
+
+  auto next = renderer.state.rhi->nextResourceUpdateBatch();
+  next->readBackTexture(QRhiReadbackDescription{m_renderTarget.texture}, m_readback);
+  cb.endPass(next);
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <Gfx/Graph/NodeRenderer.hpp>
+#include <Gfx/Graph/OutputNode.hpp>
+#include <Gfx/Graph/RenderList.hpp>
+
+namespace Hyperion
+{
+// Output renderer used instead of Gfx::InvertYRenderer when the send
+// resolution is smaller than the render resolution: the input is rendered
+// at full size, then a single pass flips it and box-averages every block
+// of source texels into one pixel of the small target, which is the only
+// texture read back.
+class DownscaleRenderer final : public score::gfx::OutputNodeRenderer
+{
+public:
+  DownscaleRenderer(
+      const score::gfx::OutputNode& node, score::gfx::TextureRenderTarget rt,
+      QRhiReadbackResult& readback);
+  ~DownscaleRenderer();
+
+  void updateReadback(QRhiReadbackResult& rb) { m_readback = &rb; }
+
+private:
+  score::gfx::TextureRenderTarget
+  renderTargetForInput(const score::gfx::Port& p) override;
+  void init(score::gfx::RenderList& renderer, QRhiResourceUpdateBatch& res) override;
+  void update(
+      score::gfx::RenderList& renderer, QRhiResourceUpdateBatch& res,
+      score::gfx::Edge* edge) override;
+  void release(score::gfx::RenderList&) override;
+  void finishFrame(
+      score::gfx::RenderList& renderer, QRhiCommandBuffer& cb,
+      QRhiResourceUpdateBatch*& res) override;
+
+  score::gfx::TextureRenderTarget m_inputTarget;
+  score::gfx::TextureRenderTarget m_renderTarget;
+  QRhiBuffer* m_ubo{};
+  QRhiSampler* m_sampler{};
+  QRhiShaderResourceBindings* m_srb{};
+  QRhiGraphicsPipeline* m_pipeline{};
+  QRhiReadbackResult* m_readback{};
+};
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+namespace Hyperion
+{
+// Shaders of DownscaleRenderer, also rendered by its test against a CPU reference
+
+// Full-screen triangle generated from the vertex index, no vertex buffer needed
+inline constexpr auto downscaleVertexShader = R"_(#version 450
+out gl_PerVertex { vec4 gl_Position; };
+
+void main()
+{
+  vec2 pos = vec2(float((gl_VertexIndex << 1) & 2), float(gl_VertexIndex & 2));
+  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)_";
+
+// gl_FragCoord and texelFetch both address texture memory rows on every
+// backend, so the Y flip only depends on the framebuffer orientation.
+// Source blocks partition the input exactly: every texel is averaged once.
+inline constexpr auto downscaleFragmentShader = R"_(#version 450
+layout(std140, binding = 0) uniform buf {
+  ivec2 srcSize;
+  ivec2 dstSize;
+  int flip;
+};
+layout(binding = 1) uniform sampler2D tex;
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+  ivec2 o = ivec2(gl_FragCoord.xy);
+  ivec2 p0 = (o * srcSize) / dstSize;
+  ivec2 p1 = max(p0 + 1, ((o + 1) * srcSize) / dstSize);
+
+  vec4 sum = vec4(0.0);
+  for(int y = p0.y; y < p1.y; ++y)
+  {
+    int sy = flip != 0 ? srcSize.y - 1 - y : y;
+    for(int x = p0.x; x < p1.x; ++x)
+      sum += texelFetch(tex, ivec2(x, sy), 0);
+  }
+  fragColor = sum / float((p1.x - p0.x) * (p1.y - p0.y));
+}
+)_";
+
+// Uniform buffer of the fragment shader, std140 layout
+struct DownscaleParams
+{
+  int32_t srcSize[2];
+  int32_t dstSize[2];
+  int32_t flip;
+  int32_t padding[3];
+
+  // `flip`: the framebuffer has Y up, i.e. QRhi::isYUpInFramebuffer()
+  static DownscaleParams
+  make(int srcWidth, int srcHeight, int dstWidth, int dstHeight, bool flip) noexcept
+  {
+    return {
+        .srcSize = {srcWidth, srcHeight},
+        .dstSize = {dstWidth, dstHeight},
+        .flip = flip ? 1 : 0,
+        .padding = {}};
+  }
+};
+}
@@ -0,0 +1,141 @@
+#include "FrameEncoder.hpp"
+#include "Metrics.hpp"
+#include "PixelConversion.hpp"
+#include "RowBandPool.hpp"
+
+#include "hyperion_request_generated.h"
+
+namespace Hyperion
+{
+template <typename T>
+static void finish(EncodedFrame& frame, flatbuffers::Offset<T> command, hyperionnet::Command type)
+{
+  auto req = hyperionnet::CreateRequest(frame.builder, type, command.Union());
+  frame.builder.Finish(req);
+
+  // Size prefix (4 bytes, big-endian)
+  const uint32_t size = frame.builder.GetSize();
+  frame.header[0] = (size >> 24) & 0xFF;
+  frame.header[1] = (size >> 16) & 0xFF;
+  frame.header[2] = (size >> 8) & 0xFF;
+  frame.header[3] = size & 0xFF;
+}
+
+static void convertRows(
+    const uint8_t* rgba, uint8_t* rgb, std::size_t pixels, const ColorLut* lut)
+{
+  if(lut)
+    rgbaToRgbLut(rgba, rgb, pixels, *lut);
+  else
+    rgbaToRgb(rgba, rgb, pixels);
+}
+
+static void convertPixels(
+    const uint8_t* rgba, uint8_t* rgb, int width, int height, RowBandPool* bands,
+    const ColorLut* lut)
+{
+  if(!bands)
+  {
+    convertRows(rgba, rgb, size_t(width) * size_t(height), lut);
+    return;
+  }
+
+  bands->forEachBand(width, height, [=](int begin, int end) {
+    const size_t first = size_t(begin) * size_t(width);
+    convertRows(rgba + first * 4, rgb + first * 3, size_t(end - begin) * size_t(width), lut);
+  });
+}
+
+void encodeImage(
+    EncodedFrame& frame, const uint8_t* rgba, int width, int height, int duration,
+    Metrics* metrics, RowBandPool* bands, const ColorLut* lut)
+{
+  using clock = std::chrono::steady_clock;
+  const auto t0 = metrics ? clock::now() : clock::time_point{};
+
+  auto& b = frame.builder;
+  const size_t pixelCount = size_t(width) * size_t(height);
+
+  // Same message layout as the previous image: patch the pixels in place
+  if(const auto& l = frame.imageLayout;
+     l && l->width == width && l->height == height && l->duration == duration)
+  {
+    const auto t1 = metrics ? clock::now() : clock::time_point{};
+    convertPixels(rgba, b.GetBufferPointer() + l->pixels, width, height, bands, lut);
+    const auto t2 = metrics ? clock::now() : clock::time_point{};
+
+    if(metrics)
+    {
+      metrics->conversion.record(t2 - t1);
+      metrics->serialization.record(t1 - t0);
+    }
+    frame.color = -1;
+    return;
+  }
+
+  b.Clear();
+
+  uint8_t* rgb{};
+  auto imgData = b.CreateUninitializedVector<uint8_t>(pixelCount * 3, &rgb);
+
+  const auto t1 = metrics ? clock::now() : clock::time_point{};
+  convertPixels(rgba, rgb, width, height, bands, lut);
+  const auto t2 = metrics ? clock::now() : clock::time_point{};
+
+  // The builder grows downwards: the distance to the end of the buffer stays
+  // valid when it reallocates, unlike `rgb`
+  const size_t fromEnd = b.GetSize() - (rgb - b.GetCurrentBufferPointer());
+
+  auto rawImg = hyperionnet::CreateRawImage(b, imgData, width, height);
+  auto imageReq = hyperionnet::CreateImage(
+      b, hyperionnet::ImageType_RawImage, rawImg.Union(), duration);
+  finish(frame, imageReq, hyperionnet::Command_Image);
+
+  if(metrics)
+  {
+    metrics->conversion.record(t2 - t1);
+    metrics->serialization.record((t1 - t0) + (clock::now() - t2));
+  }
+
+  frame.width = width;
+  frame.height = height;
+  frame.color = -1;
+  frame.imageLayout = EncodedFrame::ImageLayout{
+      .width = width, .height = height, .duration = duration, .pixels = b.GetSize() - fromEnd};
+}
+
+void encodeColor(EncodedFrame& frame, uint32_t rgb, int width, int height, int duration)
+{
+  auto& b = frame.builder;
+  b.Clear();
+  frame.imageLayout.reset();
+
+  auto colorReq = hyperionnet::CreateColor(b, int(rgb & 0xFFFFFF), duration);
+  finish(frame, colorReq, hyperionnet::Command_Color);
+
+  frame.width = width;
+  frame.height = height;
+  frame.color = int(rgb & 0xFFFFFF);
+}
+
+void encodeRegister(EncodedFrame& frame, std::string_view origin, int priority)
+{
+  auto& b = frame.builder;
+  b.Clear();
+  frame.imageLayout.reset();
+
+  auto str = b.CreateString(origin.data(), origin.size());
+  auto registerReq = hyperionnet::CreateRegister(b, str, priority);
+  finish(frame, registerReq, hyperionnet::Command_Register);
+}
+
+void encodeClear(EncodedFrame& frame, int priority)
+{
+  auto& b = frame.builder;
+  b.Clear();
+  frame.imageLayout.reset();
+
+  auto clearReq = hyperionnet::CreateClear(b, priority);
+  finish(frame, clearReq, hyperionnet::Command_Clear);
+}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <flatbuffers/flatbuffers.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace Hyperion
+{
+struct ColorLut;
+struct Metrics;
+class RowBandPool;
+
+// A serialized Request along with its 4-byte big-endian size prefix.
+// The builder keeps its storage across Clear(), so encoding the same
+// resolution again does not allocate.
+struct EncodedFrame
+{
+  // Where the pixels of the Image message in the builder are. The rest of
+  // the message only depends on these parameters: an image with the same
+  // ones is encoded by overwriting the pixels, without touching the builder.
+  struct ImageLayout
+  {
+    int width{};
+    int height{};
+    int duration{};
+    std::size_t pixels{};
+  };
+
+  // The builder's first allocation is `capacity` bytes, or the size of the
+  // first message if larger
+  explicit EncodedFrame(std::size_t capacity = 1024)
+      : builder{capacity}
+  {
+  }
+
+  flatbuffers::FlatBufferBuilder builder;
+  std::array<uint8_t, 4> header{};
+  int width{};
+  int height{};
+  // 0x00RRGGBB when the frame is a Color command instead of an image, -1 otherwise
+  int color{-1};
+  std::optional<ImageLayout> imageLayout;
+  // When the frame started rendering, to measure the render-to-send latency
+  std::chrono::steady_clock::time_point rendered{};
+  // Set by the first link which sends the frame, so that it is counted once
+  mutable std::atomic_bool sent{};
+
+  std::span<const uint8_t> body() const noexcept
+  {
+    return {builder.GetBufferPointer(), builder.GetSize()};
+  }
+};
+
+// Upper bound of the FlatBuffers overhead of a message: tables, vtables,
+// alignment padding and the builder's scratch space
+constexpr std::size_t maxMessageOverhead = 256;
+
+// Enough room to encode an image of this size without the builder growing
+constexpr std::size_t encodedImageCapacity(int width, int height) noexcept
+{
+  return std::size_t(width) * std::size_t(height) * 3 + maxMessageOverhead;
+}
+
+// The RGB conversion writes straight into the builder's vector storage:
+// the RGBA readback is the only source that gets copied. When the frame
+// already holds an image of the same size and duration, only its pixels
+// are rewritten, which gives the same bytes as a full encoding.
+// Conversion and serialization times are recorded in `metrics` when given.
+// Large frames are converted in row bands on `bands` when given.
+// The channels are mapped through `lut` during the conversion when given.
+void encodeImage(
+    EncodedFrame& frame, const uint8_t* rgba, int width, int height, int duration,
+    Metrics* metrics = nullptr, RowBandPool* bands = nullptr, const ColorLut* lut = nullptr);
+// A uniform frame as a Color command, a few bytes whatever the resolution
+void encodeColor(EncodedFrame& frame, uint32_t rgb, int width, int height, int duration);
+void encodeRegister(EncodedFrame& frame, std::string_view origin, int priority);
+void encodeClear(EncodedFrame& frame, int priority);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <mutex>
+#include <utility>
+
+namespace Hyperion
+{
+// Single-slot mailbox where a newer frame replaces an unsent one.
+// Frames are passed around by handle (e.g. a shared_ptr to a pooled frame)
+// so that the same encoded frame can be posted to several mailboxes.
+template <typename Handle>
+class FrameMailbox
+{
+public:
+  // Producer side: moves `frame` into the slot.
+  // Returns true if an unsent frame got superseded.
+  bool post(Handle frame)
+  {
+    std::lock_guard lock{m_mutex};
+    std::swap(frame, m_slot);
+    return std::exchange(m_fresh, true);
+  }
+
+  // Consumer side: moves the new frame into `frame` if there is one, without
+  // blocking, so that one consumer can serve several mailboxes
+  bool tryTake(Handle& frame)
+  {
+    std::lock_guard lock{m_mutex};
+    if(!m_fresh)
+      return false;
+
+    frame = std::exchange(m_slot, Handle{});
+    m_fresh = false;
+    return true;
+  }
+
+  // True if a frame is waiting to be taken
+  bool pending()
+  {
+    std::lock_guard lock{m_mutex};
+    return m_fresh;
+  }
+
+  // Drops the pending frame if there is one, returns true if a frame was dropped
+  bool discard()
+  {
+    Handle dropped;
+    std::lock_guard lock{m_mutex};
+    dropped = std::exchange(m_slot, Handle{});
+    return std::exchange(m_fresh, false);
+  }
+
+private:
+  std::mutex m_mutex;
+  Handle m_slot{};
+  bool m_fresh{false};
+};
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Hyperion
+{
+// Recycles frames shared with the sender threads: a frame can be reused
+// once every link has released its reference to it.
+// Frames are sorted in power-of-two size classes of their buffer, so that a
+// small message never takes, and grows, the frame of a large one. The free
+// frames of a class which has not been asked for in a while are released,
+// which gives the memory back when the resolution drops.
+// Frame must be constructible from a buffer capacity.
+template <typename Frame>
+class FramePool
+{
+public:
+  // Render thread only. `capacity` is the largest message the frame will hold.
+  std::shared_ptr<Frame> acquire(std::size_t capacity)
+  {
+    const std::size_t size = classSize(capacity);
+    m_acquires++;
+
+    std::shared_ptr<Frame> found;
+    for(auto it = m_frames.begin(); it != m_frames.end();)
+    {
+      if(it->size == size)
+      {
+        it->lastUse = m_acquires;
+        if(!found && it->frame.use_count() == 1)
+        {
+          // Pairs with the release done by the other threads when dropping their reference
+          std::atomic_thread_fence(std::memory_order_acquire);
+          found = it->frame;
+        }
+        ++it;
+      }
+      else if(m_acquires - it->lastUse > idleAcquires && it->frame.use_count() == 1)
+      {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        it = m_frames.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    if(found)
+      return found;
+
+    return m_frames.emplace_back(Entry{std::make_shared<Frame>(size), size, m_acquires}).frame;
+  }
+
+private:
+  static constexpr std::size_t minClassSize = 1024;
+  // A couple of seconds at the usual frame rates
+  static constexpr uint64_t idleAcquires = 120;
+
+  static std::size_t classSize(std::size_t capacity) noexcept
+  {
+    return std::bit_ceil(std::max(capacity, minClassSize));
+  }
+
+  struct Entry
+  {
+    std::shared_ptr<Frame> frame;
+    std::size_t size{};
+    uint64_t lastUse{};
+  };
+
+  std::vector<Entry> m_frames;
+  uint64_t m_acquires{};
+};
+}
@@ -1,250 +1,269 @@
 // FlatBuffers implementation for Hyperion protocol
-// Uses POSIX sockets directly for reliable operation in render thread
+// Frames are encoded once on the render thread and fanned out to one
+// HyperionLink per target, each sending from its own thread
 
 #include "HyperionConnection.hpp"
+#include "FrameEncoder.hpp"
+#include "FramePool.hpp"
+#include "HyperionLink.hpp"
+#include "Metrics.hpp"
 #include "OutputSettings.hpp"
+#include "PixelConversion.hpp"
+#include "RowBandPool.hpp"
+#include "StreamCapture.hpp"
 
 #include <QDebug>
 
-#include <flatbuffers/flatbuffers.h>
-#include "hyperion_request_generated.h"
-
-#include <vector>
-#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
-
-// POSIX socket includes
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netinet/tcp.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <errno.h>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace Hyperion
 {
+namespace
+{
+using clock = std::chrono::steady_clock;
+}
 
 class HyperionConnectionImpl
 {
 public:
-  explicit HyperionConnectionImpl(const OutputSettings& settings)
+  HyperionConnectionImpl(const OutputSettings& settings, std::shared_ptr<Metrics> metrics)
       : m_settings{settings}
-      , m_builder{new flatbuffers::FlatBufferBuilder()}
+      , m_metrics{
+            metrics ? std::move(metrics) : std::make_shared<Metrics>(settings.targets().size())}
+      , m_bands{settings.conversionThreads}
   {
-    doConnect();
-  }
-
-  ~HyperionConnectionImpl()
-  {
-    if(m_connected)
-      sendClear();
-    
-    if(m_socket >= 0)
+    if(settings.colorCorrected())
     {
-      ::close(m_socket);
-      m_socket = -1;
+      m_lut = ColorLut::make(
+          settings.brightness / 100., settings.gamma, settings.whiteRed / 100.,
+          settings.whiteGreen / 100., settings.whiteBlue / 100.);
     }
-    
-    delete m_builder;
-  }
-  
-  HyperionConnectionImpl(const HyperionConnectionImpl&) = delete;
-  HyperionConnectionImpl& operator=(const HyperionConnectionImpl&) = delete;
-
-  bool isConnected() const { return m_connected; }
 
-  void doConnect()
-  {
-    m_socket = ::socket(AF_INET, SOCK_STREAM, 0);
-    if(m_socket < 0)
-    {
-      qWarning() << "Hyperion: Failed to create socket:" << strerror(errno);
-      return;
-    }
-    
-    // Set TCP_NODELAY for immediate sending
-    int flag = 1;
-    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
-    
-    // Set send buffer size
-    int bufSize = 1024 * 1024; // 1MB
-    setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
-    
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(m_settings.port);
-    
-    if(inet_pton(AF_INET, m_settings.host.toStdString().c_str(), &addr.sin_addr) <= 0)
+    if(!settings.captureFile.isEmpty())
     {
-      qWarning() << "Hyperion: Invalid address:" << m_settings.host;
-      ::close(m_socket);
-      m_socket = -1;
-      return;
+      m_recorder = std::make_shared<StreamRecorder>();
+      if(m_recorder->open(settings.captureFile.toStdString()))
+      {
+        qDebug() << "Hyperion: Recording the stream to" << settings.captureFile;
+      }
+      else
+      {
+        qWarning() << "Hyperion: Cannot create capture file" << settings.captureFile << ":"
+                   << strerror(errno);
+        m_recorder.reset();
+      }
     }
-    
-    if(::connect(m_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+
+    // The main target's stream is the one recorded
+    for(const auto& target : settings.targets())
     {
-      qWarning() << "Hyperion: Failed to connect to" << m_settings.host << ":" << m_settings.port << "-" << strerror(errno);
-      ::close(m_socket);
-      m_socket = -1;
-      return;
+      const std::size_t index = m_links.size();
+      m_links.push_back(std::make_unique<HyperionLink>(
+          settings, target, m_metrics, index, index == 0 ? m_recorder : nullptr));
     }
-    
-    m_connected = true;
-    qDebug() << "Hyperion: Connected to" << m_settings.host << ":" << m_settings.port;
-    
-    sendRegister();
+
+    if(m_links.size() > 1)
+      qDebug() << "Hyperion: Sending to" << m_links.size() << "instances";
   }
 
-  void sendRegister()
+  HyperionConnectionImpl(const HyperionConnectionImpl&) = delete;
+  HyperionConnectionImpl& operator=(const HyperionConnectionImpl&) = delete;
+
+  bool isConnected() const
   {
-    auto origin = m_builder->CreateString(m_settings.origin.toStdString());
-    auto registerReq = hyperionnet::CreateRegister(*m_builder, origin, m_settings.priority);
-    auto req = hyperionnet::CreateRequest(*m_builder, hyperionnet::Command_Register, registerReq.Union());
-    
-    m_builder->Finish(req);
-    
-    qDebug() << "Hyperion: Sending Register command, size:" << m_builder->GetSize() 
-             << "origin:" << m_settings.origin << "priority:" << m_settings.priority;
-    
-    sendFlatBuffer();
-    m_builder->Clear();
+    return std::any_of(m_links.begin(), m_links.end(), [](const auto& link) {
+      return link->isConnected();
+    });
   }
 
-  void sendClear()
+  ConnectionStatistics statistics() const
   {
-    auto clearReq = hyperionnet::CreateClear(*m_builder, m_settings.priority);
-    auto req = hyperionnet::CreateRequest(*m_builder, hyperionnet::Command_Clear, clearReq.Union());
-    
-    m_builder->Finish(req);
-    sendFlatBuffer();
-    m_builder->Clear();
+    ConnectionStatistics res{};
+    for(const auto& link : m_links)
+    {
+      const auto s = link->statistics();
+      res.sent += s.sent;
+      res.dropped += s.dropped;
+      res.superseded += s.superseded;
+      res.acknowledged += s.acknowledged;
+      res.inFlight += s.inFlight;
+      res.effectiveRate = std::max(res.effectiveRate, s.effectiveRate);
+      res.latency = std::max(res.latency, s.latency);
+    }
+    res.superseded += m_superseded.load(std::memory_order_relaxed);
+    res.deduplicated = m_deduplicated.load(std::memory_order_relaxed);
+    res.colors = m_colors.load(std::memory_order_relaxed);
+    return res;
   }
 
-  void sendImage(const uint8_t* data, int width, int height, int duration)
+  std::vector<TargetStatistics> targetStatistics() const
   {
-    if(!m_connected || m_socket < 0)
-      return;
+    std::vector<TargetStatistics> res;
+    res.reserve(m_links.size());
+    for(const auto& link : m_links)
+    {
+      const auto& target = link->target();
+      res.push_back(
+          {.host = target.host,
+           .port = target.port,
+           .localSocket = target.localSocket,
+           .priority = target.priority,
+           .connected = link->isConnected(),
+           .statistics = link->statistics()});
+    }
+    return res;
+  }
 
+  // Render thread side: encode the frame into a pooled buffer and post it to every link
+  void postImage(
+      const uint8_t* data, int width, int height, int duration,
+      clock::time_point rendered)
+  {
     if(width <= 0 || height <= 0 || !data)
       return;
 
-    // Log first frame and then every 100th frame
-    if(m_frameCount == 0 || m_frameCount % 100 == 0)
+    // A new connection does not have our last image yet
+    uint32_t generation{};
+    for(const auto& link : m_links)
+      generation += link->generation();
+    if(generation != m_seenGeneration)
     {
-      qDebug() << "Hyperion: Sending image frame" << m_frameCount << "size:" << width << "x" << height;
+      m_seenGeneration = generation;
+      m_lastHash.reset();
     }
-    m_frameCount++;
-
-    // Convert RGBA to RGB (strip alpha channel)
-    size_t pixelCount = width * height;
-    size_t rgbSize = pixelCount * 3;
-    
-    // Reuse buffer to avoid repeated allocations
-    if(m_rgbBuffer.size() < rgbSize)
-      m_rgbBuffer.resize(rgbSize);
-    
-    uint8_t* dst = m_rgbBuffer.data();
-    const uint8_t* src = data;
-    
-    for(size_t i = 0; i < pixelCount; ++i)
+
+    // Nobody to send to: count the drop without encoding anything
+    if(!isConnected())
     {
-      dst[0] = src[0]; // R
-      dst[1] = src[1]; // G
-      dst[2] = src[2]; // B
-      dst += 3;
-      src += 4;
+      m_metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+      for(const auto& link : m_links)
+        link->post(nullptr);
+      return;
     }
 
-    auto imgData = m_builder->CreateVector(m_rgbBuffer.data(), rgbSize);
-    auto rawImg = hyperionnet::CreateRawImage(*m_builder, imgData, width, height);
-    auto imageReq = hyperionnet::CreateImage(*m_builder, hyperionnet::ImageType_RawImage, rawImg.Union(), duration);
-    auto req = hyperionnet::CreateRequest(*m_builder, hyperionnet::Command_Image, imageReq.Union());
-    
-    m_builder->Finish(req);
-    sendFlatBuffer();
-    m_builder->Clear();
-  }
-
-private:
-  void sendFlatBuffer()
-  {
-    if(m_socket < 0)
-      return;
-      
-    uint32_t size = m_builder->GetSize();
-    
-    if(size == 0)
-      return;
-    
-    // Size prefix (4 bytes, big-endian)
-    uint8_t header[4];
-    header[0] = (size >> 24) & 0xFF;
-    header[1] = (size >> 16) & 0xFF;
-    header[2] = (size >> 8) & 0xFF;
-    header[3] = size & 0xFF;
-    
-    // Send header
-    if(!sendAll(header, 4))
+    // Before any work on the pixels, not even hashing them
+    if(willBeSuperseded(clock::now()))
     {
-      handleDisconnect();
+      m_superseded.fetch_add(1, std::memory_order_relaxed);
+      m_metrics->superseded.fetch_add(1, std::memory_order_relaxed);
       return;
     }
-    
-    // Send data
-    if(!sendAll(m_builder->GetBufferPointer(), size))
+
+    if(m_settings.deduplicate)
     {
-      handleDisconnect();
-      return;
+      if(isDuplicate(data, width, height))
+      {
+        m_deduplicated.fetch_add(1, std::memory_order_relaxed);
+        m_metrics->deduplicated.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      // Let Hyperion drop the image by itself if the keep-alives stop coming,
+      // leaving room for a couple of late ones
+      if(duration < 0 && m_settings.keepAlive > 0)
+        duration = 3 * m_settings.keepAlive;
     }
+
+    // A negative tolerance disables the check
+    const auto color
+        = uniformColor(data, size_t(width) * size_t(height), m_settings.colorTolerance);
+    // Colors and images take frames of their own size, which keep their buffer and layout
+    auto frame = m_pool.acquire(
+        color ? maxMessageOverhead : encodedImageCapacity(width, height));
+    if(color)
+    {
+      // Fades, blackouts and washes: 4 bytes of color instead of the whole image
+      encodeColor(*frame, m_lut ? m_lut->apply(*color) : *color, width, height, duration);
+      m_colors.fetch_add(1, std::memory_order_relaxed);
+      m_metrics->colors.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      encodeImage(
+          *frame, data, width, height, duration, m_metrics.get(), &m_bands,
+          m_lut ? &*m_lut : nullptr);
+    }
+    frame->rendered = rendered;
+    frame->sent.store(false, std::memory_order_relaxed);
+
+    for(const auto& link : m_links)
+      link->post(frame);
   }
-  
-  bool sendAll(const uint8_t* data, size_t len)
+
+private:
+  // With a send rate below the render rate, paced sends take the newest frame:
+  // a frame is not worth converting when the next send slot of every connected
+  // link is more than half a render interval away, as a newer render would be
+  // closer to it. Should that render come after the slot, the link sends it
+  // as soon as it is posted, and the schedule holds.
+  bool willBeSuperseded(clock::time_point now) const
   {
-    size_t sent = 0;
-    while(sent < len)
+    if(m_settings.rate <= 0.)
+      return false;
+    const auto horizon = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(0.5 / m_settings.rate));
+
+    for(const auto& link : m_links)
     {
-      ssize_t n = ::send(m_socket, data + sent, len - sent, MSG_NOSIGNAL);
-      if(n <= 0)
-      {
-        if(errno == EINTR)
-          continue;
-        qWarning() << "Hyperion: Send failed:" << strerror(errno);
+      if(!link->isConnected())
+        continue;
+      const auto next = link->nextSendAt();
+      if(next == clock::time_point{} || next <= now + horizon)
         return false;
-      }
-      sent += n;
     }
     return true;
   }
-  
-  void handleDisconnect()
+
+  // Render thread: a frame is a duplicate if it hashes like the previous
+  // one and the last send is recent enough not to need a keep-alive
+  bool isDuplicate(const uint8_t* data, int width, int height)
   {
-    if(m_connected)
-    {
-      qDebug() << "Hyperion: Disconnected";
-      m_connected = false;
-    }
-    if(m_socket >= 0)
+    const auto now = clock::now();
+    const uint64_t hash = hashPixels(data, size_t(width) * size_t(height) * 4)
+                          ^ (uint64_t(width) << 32 | uint32_t(height));
+
+    if(m_lastHash == hash)
     {
-      ::close(m_socket);
-      m_socket = -1;
+      if(m_settings.keepAlive <= 0
+         || now - m_lastPost < std::chrono::milliseconds{m_settings.keepAlive})
+        return true;
     }
+
+    m_lastHash = hash;
+    m_lastPost = now;
+    return false;
   }
 
   OutputSettings m_settings;
-  int m_socket{-1};
-  bool m_connected{false};
-  int m_frameCount{0};
-  std::vector<uint8_t> m_rgbBuffer;
-  flatbuffers::FlatBufferBuilder* m_builder;
+  std::shared_ptr<Metrics> m_metrics;
+  // Shared with the main target's link, which may go on until its Clear is sent
+  std::shared_ptr<StreamRecorder> m_recorder;
+  std::vector<std::unique_ptr<HyperionLink>> m_links;
+  RowBandPool m_bands;
+  std::optional<ColorLut> m_lut;
+  FramePool<EncodedFrame> m_pool;
+
+  std::atomic<uint64_t> m_superseded{};
+  std::atomic<uint64_t> m_deduplicated{};
+  std::atomic<uint64_t> m_colors{};
+
+  // Render thread deduplication state
+  std::optional<uint64_t> m_lastHash;
+  clock::time_point m_lastPost;
+  uint32_t m_seenGeneration{};
 };
 
 // Public interface
 
-HyperionConnection::HyperionConnection(const OutputSettings& settings)
-    : m_impl{std::make_unique<HyperionConnectionImpl>(settings)}
+HyperionConnection::HyperionConnection(
+    const OutputSettings& settings, std::shared_ptr<Metrics> metrics)
+    : m_impl{std::make_unique<HyperionConnectionImpl>(settings, std::move(metrics))}
 {
 }
 
@@ -255,9 +274,21 @@ bool HyperionConnection::isConnected() const
   return m_impl->isConnected();
 }
 
-void HyperionConnection::sendImage(const uint8_t* data, int width, int height, int duration)
+void HyperionConnection::sendImage(
+    const uint8_t* data, int width, int height, int duration,
+    std::chrono::steady_clock::time_point rendered)
+{
+  m_impl->postImage(data, width, height, duration, rendered);
+}
+
+ConnectionStatistics HyperionConnection::statistics() const
+{
+  return m_impl->statistics();
+}
+
+std::vector<TargetStatistics> HyperionConnection::targetStatistics() const
 {
-  m_impl->sendImage(data, width, height, duration);
+  return m_impl->targetStatistics();
 }
 
 }
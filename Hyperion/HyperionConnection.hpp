@@ -1,26 +1,75 @@
 #pragma once
 
 #include <QString>
+
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace Hyperion
 {
+struct Metrics;
 struct OutputSettings;
 
 class HyperionConnectionImpl;
 
+struct ConnectionStatistics
+{
+  uint64_t sent{};
+  // Frames discarded because no connection was available or the send failed
+  uint64_t dropped{};
+  // Frames replaced in the mailbox by a newer one before being sent,
+  // or not even converted as a newer one would replace them
+  uint64_t superseded{};
+  // Frames identical to the previous one, covered by the keep-alive
+  uint64_t deduplicated{};
+  // Uniform frames sent as a Color command instead of an image
+  uint64_t colors{};
+  // Replies received from Hyperion
+  uint64_t acknowledged{};
+  // Requests sent and not yet acknowledged
+  uint32_t inFlight{};
+  // Image send rate after congestion control, at most the send rate
+  double effectiveRate{};
+  // Time from the start of the render to the end of the send, smoothed, in ms
+  double latency{};
+};
+
+struct TargetStatistics
+{
+  QString host;
+  int port{};
+  QString localSocket;
+  int priority{};
+  bool connected{};
+  ConnectionStatistics statistics;
+};
+
 class HyperionConnection
 {
 public:
-  HyperionConnection(const OutputSettings& settings);
+  HyperionConnection(
+      const OutputSettings& settings, std::shared_ptr<Metrics> metrics = {});
   ~HyperionConnection();
 
   // Non-copyable
   HyperionConnection(const HyperionConnection&) = delete;
   HyperionConnection& operator=(const HyperionConnection&) = delete;
 
+  // True if at least one of the targets is connected
   bool isConnected() const;
-  void sendImage(const uint8_t* data, int width, int height, int duration = -1);
+
+  // Called from the render thread: only encodes the frame once and hands it
+  // over to the sender thread of every target, the network I/O happens there.
+  void sendImage(
+      const uint8_t* data, int width, int height, int duration = -1,
+      std::chrono::steady_clock::time_point rendered = {});
+
+  // Summed over all the targets: a frame sent to two targets counts twice.
+  // The Metrics count each frame once.
+  ConnectionStatistics statistics() const;
+  std::vector<TargetStatistics> targetStatistics() const;
 
 private:
   std::unique_ptr<HyperionConnectionImpl> m_impl;
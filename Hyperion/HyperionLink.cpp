@@ -0,0 +1,1149 @@
+// Connection to a single Hyperion instance
+// Uses POSIX sockets directly, driven from a dedicated sender thread.
+// Outputs sending to the same instance share its socket: every HyperionLink
+// is a channel multiplexed over the HyperionSocket of its address.
+
+#include "HyperionLink.hpp"
+#include "FrameEncoder.hpp"
+#include "FrameMailbox.hpp"
+#include "Metrics.hpp"
+#include "OutputSettings.hpp"
+#include "PacingTimer.hpp"
+#include "PixelConversion.hpp"
+#include "RateController.hpp"
+#include "ReplyReader.hpp"
+#include "RingQueue.hpp"
+#include "StreamCapture.hpp"
+#include "ZeroCopy.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// POSIX socket includes
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <linux/sockios.h>
+#endif
+
+namespace Hyperion
+{
+namespace
+{
+using clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr auto connectTimeout = 3s;
+constexpr auto sendTimeout = 5s;
+constexpr auto clearTimeout = 500ms;
+// A peer that does not answer within this delay is assumed not to send replies
+constexpr auto ackTimeout = 3s;
+// How often replies are drained when no frame comes in
+constexpr auto replyPollInterval = 50ms;
+// How long a closing socket waits for the kernel to be done with zero-copy frames
+constexpr auto zeroCopyDrainTimeout = 100ms;
+constexpr auto initialBackoff = 250ms;
+constexpr auto maxBackoff = 10s;
+
+// Bytes queued in the kernel for the socket and not yet acknowledged by the peer
+std::size_t unsentBytes(int fd)
+{
+  int n = 0;
+#if defined(__linux__)
+  if(::ioctl(fd, SIOCOUTQ, &n) == 0)
+    return std::max(n, 0);
+#elif defined(__APPLE__)
+  socklen_t len = sizeof(n);
+  if(::getsockopt(fd, SOL_SOCKET, SO_NWRITE, &n, &len) == 0)
+    return std::max(n, 0);
+#endif
+  return 0;
+}
+}
+
+class HyperionSocket;
+
+// One output's stream to one Hyperion instance: its mailbox, priority,
+// pacing, congestion control and statistics. The socket's sender thread
+// owns everything below `Sender thread state`, and the link itself once
+// the output has gone away, until the link's Clear is sent.
+class HyperionLinkImpl
+{
+public:
+  HyperionLinkImpl(
+      const OutputSettings& settings, const OutputTarget& target,
+      std::shared_ptr<Metrics> metrics, std::size_t index,
+      std::shared_ptr<StreamRecorder> recorder, HyperionSocket& socket);
+
+  HyperionLinkImpl(const HyperionLinkImpl&) = delete;
+  HyperionLinkImpl& operator=(const HyperionLinkImpl&) = delete;
+
+  const OutputTarget& target() const noexcept { return m_target; }
+  bool isConnected() const { return m_connected; }
+  uint32_t generation() const { return m_generation.load(std::memory_order_acquire); }
+
+  clock::time_point nextSendAt() const
+  {
+    return clock::time_point{clock::duration{m_pacedUntil.load(std::memory_order_relaxed)}};
+  }
+
+  ConnectionStatistics statistics() const
+  {
+    return {
+        .sent = m_sent.load(std::memory_order_relaxed),
+        .dropped = m_dropped.load(std::memory_order_relaxed),
+        .superseded = m_superseded.load(std::memory_order_relaxed),
+        .acknowledged = m_acknowledged.load(std::memory_order_relaxed),
+        .inFlight = m_inFlight.load(std::memory_order_relaxed),
+        .effectiveRate = m_effectiveRate.load(std::memory_order_relaxed),
+        .latency = m_latency.load(std::memory_order_relaxed)};
+  }
+
+  // Render thread side: frames are dropped, not queued, while the link is down
+  void post(std::shared_ptr<const EncodedFrame> frame);
+
+private:
+  friend class HyperionSocket;
+
+  void setConnected(bool connected)
+  {
+    if(m_connected.exchange(connected) != connected)
+      m_metrics->connectedTargets.fetch_add(connected ? 1 : -1, std::memory_order_relaxed);
+    if(m_targetMetrics)
+      m_targetMetrics->connected.store(connected, std::memory_order_relaxed);
+  }
+
+  void setEffectiveRate(double rate)
+  {
+    m_effectiveRate.store(rate, std::memory_order_relaxed);
+    if(m_targetMetrics)
+      m_targetMetrics->sendRate.store(rate, std::memory_order_relaxed);
+  }
+
+  // Only this target missed the frame, the connection counts the frames none got
+  void countDropped()
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    if(m_targetMetrics)
+      m_targetMetrics->dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void countSent(const EncodedFrame& frame, std::size_t bytes)
+  {
+    m_sent.fetch_add(1, std::memory_order_relaxed);
+    if(m_targetMetrics)
+      m_targetMetrics->sent.fetch_add(1, std::memory_order_relaxed);
+    if(!frame.sent.exchange(true, std::memory_order_relaxed))
+      m_metrics->sent.fetch_add(1, std::memory_order_relaxed);
+    m_metrics->bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Sends are paced with a send rate below the render rate, or when congested
+  bool paced() const noexcept { return m_scheduled || m_rate.limited(); }
+
+  // Paced sends follow a fixed schedule, so that the average rate holds when
+  // one is late. A send late by half an interval or more restarts it.
+  void scheduleNextSend(clock::time_point start, bool paced)
+  {
+    const auto interval = m_rate.interval();
+    if(paced && m_lastSendAt != clock::time_point{})
+      m_metrics->sendJitter.record(std::chrono::abs(start - m_lastSendAt - interval));
+    m_lastSendAt = start;
+
+    if(start < m_nextSendAt + interval / 2)
+      m_nextSendAt += interval;
+    else
+      m_nextSendAt = start + interval;
+    publishNextSend();
+  }
+
+  // Lets the render thread skip the frames which will be superseded before the next slot
+  void publishNextSend() noexcept
+  {
+    m_pacedUntil.store(
+        paced() ? m_nextSendAt.time_since_epoch().count() : 0, std::memory_order_relaxed);
+  }
+
+  template <typename F>
+  void updateRate(F&& f)
+  {
+    const double before = m_rate.rate();
+    f();
+    const double after = m_rate.rate();
+    if(after != before)
+    {
+      setEffectiveRate(after);
+      if(after < before && !m_rateReduced)
+        qDebug() << "Hyperion: Link congested, lowering the send rate to" << after << "fps";
+      m_rateReduced = after < m_rate.maxRate();
+    }
+  }
+
+  void updateLatency(clock::duration latency)
+  {
+    const double ms = std::chrono::duration<double, std::milli>(latency).count();
+    const double prev = m_latency.load(std::memory_order_relaxed);
+    m_latency.store(prev > 0. ? prev + (ms - prev) / 16. : ms, std::memory_order_relaxed);
+  }
+
+  OutputSettings m_settings;
+  OutputTarget m_target;
+  std::string m_origin;
+  std::shared_ptr<Metrics> m_metrics;
+  TargetMetrics* m_targetMetrics{};
+  std::shared_ptr<StreamRecorder> m_recorder;
+  // Only used by the render thread, while the output holds the socket
+  HyperionSocket& m_socket;
+
+  std::atomic_bool m_connected{false};
+  // Incremented on every successful (re)connection
+  std::atomic<uint32_t> m_generation{};
+  // Set when the output goes away, interrupts a send of its frames if it is alone on the socket
+  std::atomic_bool m_closing{false};
+
+  FrameMailbox<std::shared_ptr<const EncodedFrame>> m_mailbox;
+
+  // Sender thread state
+  RateController m_rate;
+  bool m_scheduled{}; // Send rate below the render rate
+  clock::time_point m_nextSendAt{};
+  clock::time_point m_lastSendAt{};
+  std::optional<clock::time_point> m_ackWaitStart;
+  bool m_rateReduced{};
+  uint64_t m_bytesMark{}; // Socket bytes written at this link's previous send
+  bool m_logged{}; // First frame of the connection logged
+
+  std::atomic<uint64_t> m_sent{};
+  std::atomic<uint64_t> m_dropped{};
+  std::atomic<uint64_t> m_superseded{};
+  std::atomic<uint64_t> m_acknowledged{};
+  std::atomic<uint32_t> m_inFlight{};
+  std::atomic<double> m_effectiveRate{};
+  std::atomic<double> m_latency{};
+  // Next send slot while paced, 0 otherwise, in clock ticks
+  std::atomic<clock::rep> m_pacedUntil{};
+};
+
+// Socket to one Hyperion address, shared by all the links to it, with its
+// sender thread, reconnection and flow control. Images and colors carry no
+// priority in the protocol: they apply to the connection's last Register, so
+// a Register is sent again whenever the next frame is from another priority
+// or origin. That costs a small message and its reply per switch; links are
+// kept sorted by priority so that each round switches once per priority.
+// When the connection drops, Hyperion only clears the priority registered
+// last: the images of the others stay until their duration runs out, or
+// until their output sends again after reconnecting.
+class HyperionSocket
+{
+public:
+  // Process-wide registry keyed by host:port, or by path for Unix domain sockets
+  static std::shared_ptr<HyperionSocket> get(const OutputTarget& target)
+  {
+    static std::mutex mutex;
+    static std::map<QString, std::weak_ptr<HyperionSocket>> sockets;
+
+    std::lock_guard lock{mutex};
+    std::erase_if(sockets, [](const auto& entry) { return entry.second.expired(); });
+    auto& entry = sockets[target.name()];
+    if(auto socket = entry.lock())
+      return socket;
+
+    auto socket = std::make_shared<HyperionSocket>(target);
+    entry = socket;
+    return socket;
+  }
+
+  explicit HyperionSocket(const OutputTarget& target)
+      : m_target{target}
+      , m_rng{std::random_device{}()}
+  {
+    // Used to interrupt the sender thread while it waits on the socket
+    if(::pipe(m_wakePipe) == 0)
+    {
+      ::fcntl(m_wakePipe[0], F_SETFL, O_NONBLOCK);
+      ::fcntl(m_wakePipe[1], F_SETFL, O_NONBLOCK);
+    }
+
+    m_thread = std::thread{[this] { run(); }};
+  }
+
+  ~HyperionSocket()
+  {
+    m_stopped = true;
+    wake();
+
+    if(m_thread.joinable())
+      m_thread.join();
+
+    for(int& fd : m_wakePipe)
+    {
+      if(fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+  }
+
+  HyperionSocket(const HyperionSocket&) = delete;
+  HyperionSocket& operator=(const HyperionSocket&) = delete;
+
+  void attach(HyperionLinkImpl* link)
+  {
+    {
+      std::lock_guard lock{m_membersMutex};
+      m_attaching.push_back(link);
+    }
+    m_membersChanged = true;
+    wake();
+  }
+
+  // Returns right away: the sender thread clears the priority if the link
+  // was the last one, and releases the link once it does not use it anymore
+  void detach(std::shared_ptr<HyperionLinkImpl> link)
+  {
+    link->m_closing = true;
+    link->m_mailbox.discard();
+    {
+      std::lock_guard lock{m_membersMutex};
+      m_detaching.push_back(std::move(link));
+    }
+    m_membersChanged = true;
+    wake();
+  }
+
+  // Render thread, after posting a frame to a link: wakes the sender thread if it is idle
+  void notifyPosted()
+  {
+    m_posts.fetch_add(1);
+    if(m_idle.exchange(false))
+      wake();
+  }
+
+private:
+  enum class State
+  {
+    Disconnected,
+    Connecting,
+    Connected
+  };
+
+  enum class Wait
+  {
+    Ready,
+    Timeout,
+    Interrupted,
+    // Woken up by a post or a link joining or leaving
+    Woken
+  };
+
+  struct PendingReply
+  {
+    HyperionLinkImpl* link{}; // Null once the link is gone
+    clock::time_point sent;
+  };
+
+  void wake()
+  {
+    if(m_wakePipe[1] >= 0)
+    {
+      const char c = 0;
+      [[maybe_unused]] auto res = ::write(m_wakePipe[1], &c, 1);
+    }
+  }
+
+  // Sender thread
+  void run()
+  {
+    while(!m_stopped)
+    {
+      if(m_membersChanged.exchange(false))
+        updateMembers();
+
+      switch(m_state)
+      {
+        case State::Disconnected:
+          // Sleep until the next attempt, the socket is -1 so only the wake pipe is polled
+          if(waitSocket(0, m_retryAt, true) == Wait::Timeout)
+            startConnect();
+          break;
+
+        case State::Connecting:
+          finishConnect();
+          break;
+
+        case State::Connected:
+          runConnected();
+          break;
+      }
+    }
+
+    // The outputs have all left. The Clears of the last ones are only sent if
+    // they do not have to wait: closing the connection clears the priority
+    // registered last too.
+    if(m_membersChanged.exchange(false))
+      updateMembers();
+    closeSocket();
+  }
+
+  void updateMembers()
+  {
+    std::vector<HyperionLinkImpl*> attaching;
+    std::vector<std::shared_ptr<HyperionLinkImpl>> detaching;
+    {
+      std::lock_guard lock{m_membersMutex};
+      attaching.swap(m_attaching);
+      detaching.swap(m_detaching);
+    }
+
+    for(auto* link : attaching)
+    {
+      // After the links with the same registration, which are served in a row
+      const auto position = std::upper_bound(
+          m_links.begin(), m_links.end(), link, [](auto* a, auto* b) {
+            return std::tie(a->m_target.priority, a->m_origin)
+                   < std::tie(b->m_target.priority, b->m_origin);
+          });
+      m_links.insert(position, link);
+      if(m_state == State::Connected)
+      {
+        enableOptions(*link);
+        linkConnected(*link);
+      }
+    }
+
+    // The links are released when leaving the scope, after their last use
+    for(const auto& link : detaching)
+    {
+      std::erase(m_links, link.get());
+
+      // Leave Hyperion's priority free for the next source, unless another output still uses it
+      const bool shared = std::any_of(m_links.begin(), m_links.end(), [&](auto* other) {
+        return other->m_target.priority == link->m_target.priority;
+      });
+      if(m_state == State::Connected && !shared)
+        sendClear(*link);
+      link->setConnected(false);
+
+      for(std::size_t i = 0; i < m_pendingReplies.size(); i++)
+        if(m_pendingReplies[i].link == link.get())
+          m_pendingReplies[i].link = nullptr;
+    }
+  }
+
+  void runConnected()
+  {
+    if(!readReplies())
+      return;
+
+    const auto now = clock::now();
+    if(!m_repliesMissing && !m_pendingReplies.empty()
+       && now - m_pendingReplies.front().sent > ackTimeout)
+    {
+      const bool flowControl = std::any_of(m_links.begin(), m_links.end(), [](auto* link) {
+        return link->m_settings.maxInFlight > 0;
+      });
+      if(flowControl)
+        qWarning() << "Hyperion: No reply received, disabling flow control";
+      m_repliesMissing = true;
+      m_pendingReplies.clear();
+      for(auto* link : m_links)
+        link->m_inFlight = 0;
+    }
+
+    // Round-robin over the links with a frame ready, starting after the last
+    // one served, so that a busy output cannot starve the others
+    const uint64_t posts = m_posts.load();
+    auto wakeAt = now + replyPollInterval;
+    bool precise = false;
+    const std::size_t count = m_links.size();
+    for(std::size_t i = 1; i <= count; i++)
+    {
+      const std::size_t index = (m_cursor + i) % count;
+      auto& link = *m_links[index];
+      if(!link.m_mailbox.pending())
+        continue;
+
+      // Flow control: wait until Hyperion has consumed enough of what the output sent.
+      // Newer frames keep replacing the pending one in the mailbox meanwhile.
+      if(!m_repliesMissing && link.m_settings.maxInFlight > 0
+         && link.m_inFlight >= uint32_t(link.m_settings.maxInFlight))
+      {
+        if(!link.m_ackWaitStart)
+          link.m_ackWaitStart = now;
+
+        // Being held back for more than a frame means the host does not keep up
+        if(now - *link.m_ackWaitStart > link.m_rate.interval())
+          link.updateRate([&] { link.m_rate.congested(now); });
+        continue;
+      }
+      link.m_ackWaitStart.reset();
+
+      // Paced: in-between frames get superseded by the newest one
+      if(link.paced() && now < link.m_nextSendAt)
+      {
+        if(link.m_nextSendAt < wakeAt)
+        {
+          wakeAt = link.m_nextSendAt;
+          precise = true;
+        }
+        continue;
+      }
+
+      m_cursor = index;
+      sendNext(link);
+      return;
+    }
+
+    // Nothing to send yet: wait for a reply, a new frame or the next send slot.
+    // A frame posted since the scan above is not missed: either its post is
+    // seen here, or the poster sees m_idle and rings the wake pipe.
+    m_idle = true;
+    if(m_posts.load() == posts && !m_membersChanged)
+      waitSocket(POLLIN, wakeAt, true, precise);
+    m_idle = false;
+  }
+
+  void sendNext(HyperionLinkImpl& link)
+  {
+    std::shared_ptr<const EncodedFrame> frame;
+    if(!link.m_mailbox.tryTake(frame))
+      return;
+
+    const bool paced = link.paced();
+    const auto start = clock::now();
+    if(sendImage(link, frame))
+    {
+      const auto end = clock::now();
+      link.countSent(*frame, frame->header.size() + frame->body().size());
+      link.m_metrics->send.record(end - start);
+
+      if(frame->rendered != clock::time_point{})
+      {
+        link.m_metrics->latency.record(end - frame->rendered);
+        link.updateLatency(end - frame->rendered);
+      }
+
+      // What the other links sent since this one's previous frame is part of its round
+      const std::size_t round = m_bytesWritten - link.m_bytesMark;
+      link.m_bytesMark = m_bytesWritten;
+      link.updateRate(
+          [&] { link.m_rate.sent(end, round, unsentBytes(m_socket), end - start); });
+      link.scheduleNextSend(start, paced);
+    }
+    else
+    {
+      link.countDropped();
+    }
+
+    // Hand the frame back to the pool
+    frame.reset();
+  }
+
+  // Every Request gets exactly one Reply, in order: each one is matched with the
+  // oldest request sent, which is what the flow control counts
+  bool readReplies()
+  {
+    const auto status = m_replies.receive(m_socket);
+    while(auto reply = m_replies.next())
+    {
+      HyperionLinkImpl* link{};
+      if(!m_pendingReplies.empty())
+      {
+        link = m_pendingReplies.front().link;
+        m_pendingReplies.pop_front();
+      }
+      if(link)
+      {
+        if(link->m_inFlight > 0)
+          link->m_inFlight.fetch_sub(1, std::memory_order_relaxed);
+        link->m_acknowledged.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      if(!reply->error.empty())
+      {
+        if(m_replyErrors++ < 10)
+          qWarning() << "Hyperion: Error reply:" << QString::fromStdString(reply->error);
+      }
+      else if(reply->registered >= 0 && m_links.size() == 1)
+      {
+        // Several outputs register again at every switch
+        qDebug() << "Hyperion: Registered with priority" << reply->registered;
+      }
+    }
+
+    if(status != ReplyReader::Status::Ok || m_replies.desynchronized())
+    {
+      if(status == ReplyReader::Status::Closed)
+        qDebug() << "Hyperion: Connection closed by peer";
+      handleDisconnect();
+      return false;
+    }
+    return true;
+  }
+
+  void startConnect()
+  {
+    const bool local = !m_target.localSocket.isEmpty();
+    m_socket = ::socket(local ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+    if(m_socket < 0)
+    {
+      qWarning() << "Hyperion: Failed to create socket:" << strerror(errno);
+      scheduleRetry();
+      return;
+    }
+
+    ::fcntl(m_socket, F_SETFL, ::fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+
+    // Set TCP_NODELAY for immediate sending
+    if(!local)
+    {
+      int flag = 1;
+      setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    // Set send buffer size
+    int bufSize = 1024 * 1024; // 1MB
+    setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &bufSize, sizeof(bufSize));
+
+    sockaddr_storage addr{};
+    socklen_t addrLen{};
+    if(!makeAddress(addr, addrLen))
+    {
+      if(m_failures++ == 0)
+        qWarning() << "Hyperion: Invalid address:" << m_target.name();
+      closeSocket();
+      scheduleRetry();
+      return;
+    }
+
+    if(::connect(m_socket, reinterpret_cast<sockaddr*>(&addr), addrLen) == 0)
+    {
+      onConnected();
+    }
+    else if(errno == EINPROGRESS)
+    {
+      m_state = State::Connecting;
+      m_connectDeadline = clock::now() + connectTimeout;
+    }
+    else
+    {
+      connectFailed(strerror(errno));
+    }
+  }
+
+  bool makeAddress(sockaddr_storage& storage, socklen_t& len) const
+  {
+    if(!m_target.localSocket.isEmpty())
+    {
+      auto& addr = reinterpret_cast<sockaddr_un&>(storage);
+      const auto path = m_target.localSocket.toStdString();
+      if(path.size() >= sizeof(addr.sun_path))
+        return false;
+
+      addr.sun_family = AF_UNIX;
+      memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+      len = sizeof(addr);
+      return true;
+    }
+
+    auto& addr = reinterpret_cast<sockaddr_in&>(storage);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_target.port);
+    len = sizeof(addr);
+    return inet_pton(AF_INET, m_target.host.toStdString().c_str(), &addr.sin_addr) > 0;
+  }
+
+  void finishConnect()
+  {
+    switch(waitSocket(POLLOUT, m_connectDeadline, true))
+    {
+      case Wait::Interrupted:
+      case Wait::Woken:
+        return;
+      case Wait::Timeout:
+        connectFailed("timed out");
+        return;
+      case Wait::Ready:
+        break;
+    }
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if(::getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+      err = errno;
+
+    if(err != 0)
+      connectFailed(strerror(err));
+    else
+      onConnected();
+  }
+
+  void connectFailed(const char* reason)
+  {
+    // Only the first failure of a series is reported, retries are silent
+    if(m_failures++ == 0)
+      qWarning() << "Hyperion: Failed to connect to" << m_target.name() << "-" << reason
+                 << "- retrying in the background";
+    closeSocket();
+    scheduleRetry();
+  }
+
+  void onConnected()
+  {
+    qDebug() << "Hyperion: Connected to" << m_target.name();
+    m_state = State::Connected;
+    m_failures = 0;
+    m_backoff = initialBackoff;
+
+    m_replies.reset();
+    m_pendingReplies.clear();
+    m_registeredPriority = -1;
+    m_repliesMissing = false;
+    m_zeroCopyTried = false;
+
+    // Each output registers before its first frame, on every reconnection
+    for(auto* link : m_links)
+    {
+      enableOptions(*link);
+      linkConnected(*link);
+    }
+  }
+
+  // Zero-copy applies to the socket as soon as one output asks for it
+  void enableOptions(const HyperionLinkImpl& link)
+  {
+    // Enabling resets the tracker, so it is only done once per connection
+    if(!link.m_settings.zeroCopy || m_zeroCopyTried)
+      return;
+    m_zeroCopyTried = true;
+    if(!m_zeroCopy.enable(m_socket) && !m_zeroCopyWarned)
+    {
+      qDebug() << "Hyperion: Zero-copy send not supported for" << m_target.name();
+      m_zeroCopyWarned = true;
+    }
+  }
+
+  void linkConnected(HyperionLinkImpl& link)
+  {
+    const double sendRate = link.m_settings.effectiveSendRate();
+    link.m_rate.reset(sendRate);
+    link.m_scheduled = sendRate < link.m_settings.rate;
+    link.m_nextSendAt = {};
+    link.m_lastSendAt = {};
+    link.publishNextSend();
+    link.m_ackWaitStart.reset();
+    link.m_rateReduced = false;
+    link.m_bytesMark = m_bytesWritten;
+    link.m_inFlight = 0;
+    link.m_logged = false;
+    link.setEffectiveRate(link.m_rate.rate());
+
+    link.m_generation.fetch_add(1, std::memory_order_release);
+    link.setConnected(true);
+  }
+
+  // Full-jitter exponential backoff: the delay is drawn in [backoff / 2, backoff]
+  void scheduleRetry()
+  {
+    std::uniform_int_distribution<int64_t> jitter{
+        m_backoff.count() / 2, m_backoff.count()};
+    m_retryAt = clock::now() + std::chrono::milliseconds{jitter(m_rng)};
+    m_backoff = std::min<std::chrono::milliseconds>(m_backoff * 2, maxBackoff);
+    m_state = State::Disconnected;
+  }
+
+  // The connection applies images and colors to the last registered priority
+  bool ensureRegistered(HyperionLinkImpl& link)
+  {
+    if(m_registeredPriority == link.m_target.priority && m_registeredOrigin == link.m_origin)
+      return true;
+
+    encodeRegister(m_control, link.m_origin, link.m_target.priority);
+    // Only the first one of a connection is logged, the others come at every switch
+    if(m_registeredPriority < 0)
+      qDebug() << "Hyperion: Sending Register command, size:" << m_control.body().size()
+               << "origin:" << link.m_settings.origin << "priority:" << link.m_target.priority;
+
+    if(!sendFrame(link, m_control, clock::now() + sendTimeout, true))
+      return false;
+
+    // Assigned in place: the string keeps its capacity from one switch to the next
+    m_registeredPriority = link.m_target.priority;
+    m_registeredOrigin = link.m_origin;
+    if(link.m_recorder)
+      link.m_recorder->append(m_control);
+    return true;
+  }
+
+  void sendClear(HyperionLinkImpl& link)
+  {
+    // Cut short when the socket goes away or another output joins,
+    // the connection is then closed, which clears the priority registered last
+    encodeClear(m_control, link.m_target.priority);
+    if(sendFrame(link, m_control, clock::now() + clearTimeout, true) && link.m_recorder)
+      link.m_recorder->append(m_control);
+  }
+
+  bool sendImage(HyperionLinkImpl& link, const std::shared_ptr<const EncodedFrame>& ptr)
+  {
+    if(!ensureRegistered(link))
+      return false;
+
+    const auto& frame = *ptr;
+    // Only the first frame of a connection is logged: formatting allocates,
+    // the rest is followed through the metrics and statistics
+    if(!link.m_logged)
+    {
+      if(frame.color >= 0)
+        qDebug() << "Hyperion: Sending color frames to" << m_target.name()
+                 << "color:" << QString::number(frame.color, 16).rightJustified(6, '0');
+      else
+        qDebug() << "Hyperion: Sending image frames to" << m_target.name()
+                 << "size:" << frame.width << "x" << frame.height
+                 << "kernel:" << selectedRgbaToRgbKernel().name;
+      link.m_logged = true;
+    }
+
+    // Large frames may be sent from their own pages, which must then stay
+    // untouched until the kernel is done: the frame is held until completion
+    const int flags = m_zeroCopy.flags(frame.header.size() + frame.body().size());
+    if(!sendFrame(link, frame, clock::now() + sendTimeout, true, flags))
+      return false;
+
+    if(flags != 0)
+    {
+      m_zeroCopy.hold(ptr);
+      m_zeroCopy.reap(m_socket);
+    }
+    if(link.m_recorder)
+      link.m_recorder->append(ptr);
+    return true;
+  }
+
+  bool sendFrame(
+      HyperionLinkImpl& link, const EncodedFrame& frame, clock::time_point deadline,
+      bool interruptible, int flags = 0)
+  {
+    if(m_socket < 0)
+      return false;
+
+    const auto body = frame.body();
+    if(body.empty())
+      return false;
+
+    // Header and body go out in a single syscall
+    iovec iov[2];
+    iov[0].iov_base = const_cast<uint8_t*>(frame.header.data());
+    iov[0].iov_len = frame.header.size();
+    iov[1].iov_base = const_cast<uint8_t*>(body.data());
+    iov[1].iov_len = body.size();
+
+    m_sending = &link;
+    const bool sent = sendAll(iov, 2, deadline, interruptible, flags);
+    m_sending = nullptr;
+    if(!sent)
+    {
+      handleDisconnect();
+      return false;
+    }
+
+    // Requests are tracked from the start of the connection whatever the
+    // settings, so that the replies stay matched when an output with flow
+    // control joins later
+    m_bytesWritten += frame.header.size() + body.size();
+    if(!m_repliesMissing)
+    {
+      m_pendingReplies.push_back({&link, clock::now()});
+      link.m_inFlight.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  bool sendAll(
+      iovec* iov, int count, clock::time_point deadline, bool interruptible, int flags)
+  {
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    while(msg.msg_iovlen > 0)
+    {
+      ssize_t n = ::sendmsg(m_socket, &msg, MSG_NOSIGNAL | flags);
+      if(n >= 0 && flags != 0)
+        m_zeroCopy.sent();
+      if(n < 0)
+      {
+        if(errno == EINTR)
+          continue;
+
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          switch(waitSocket(POLLOUT, deadline, interruptible))
+          {
+            case Wait::Ready:
+            case Wait::Woken:
+              continue;
+            case Wait::Timeout:
+              qWarning() << "Hyperion: Send timed out";
+              return false;
+            case Wait::Interrupted:
+              return false;
+          }
+        }
+
+        qWarning() << "Hyperion: Send failed:" << strerror(errno);
+        return false;
+      }
+
+      // Skip what was written on a partial send
+      while(msg.msg_iovlen > 0 && size_t(n) >= msg.msg_iov->iov_len)
+      {
+        n -= msg.msg_iov->iov_len;
+        ++msg.msg_iov;
+        --msg.msg_iovlen;
+      }
+      if(msg.msg_iovlen > 0)
+      {
+        msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + n;
+        msg.msg_iov->iov_len -= n;
+      }
+    }
+    return true;
+  }
+
+  // Waits for `events` on the socket until the deadline.
+  // If interruptible, returns early when the socket is being destroyed, the
+  // only output whose frame is being sent goes away, or anything else wakes it up.
+  // If precise, the deadline is kept to the microsecond with the pacing timer.
+  Wait waitSocket(
+      short events, clock::time_point deadline, bool interruptible, bool precise = false)
+  {
+    // The wake-up may already have been consumed by a previous wait
+    if(interruptible && m_stopped)
+      return Wait::Interrupted;
+
+    const bool timer = precise && m_timer.fd() >= 0;
+    if(timer)
+      m_timer.arm(deadline);
+
+    for(;;)
+    {
+      pollfd fds[3]{
+          {m_socket, events, 0},
+          {interruptible ? m_wakePipe[0] : -1, POLLIN, 0},
+          {timer ? m_timer.fd() : -1, POLLIN, 0}};
+
+      // The poll timeout is rounded up: the timer fires first
+      const auto remaining
+          = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now());
+      const int r = ::poll(fds, 3, std::max<int>(0, remaining.count() + (timer ? 1 : 0)));
+      if(r < 0)
+      {
+        if(errno == EINTR)
+          continue;
+        return Wait::Interrupted;
+      }
+
+      if(fds[1].revents != 0)
+      {
+        char buf[64];
+        while(::read(m_wakePipe[0], buf, sizeof(buf)) > 0)
+          ;
+        // A message cut short would corrupt the stream of the other outputs
+        if(m_stopped || (m_sending && m_sending->m_closing && m_links.size() <= 1))
+          return Wait::Interrupted;
+        return Wait::Woken;
+      }
+      // Zero-copy completions are signaled as POLLERR, only real errors are reported
+      if((fds[0].revents & POLLERR) && m_zeroCopy.pending() > 0
+         && m_zeroCopy.reap(m_socket) > 0 && !(fds[0].revents & (events | POLLHUP)))
+        continue;
+      // Errors and hang-ups are reported by the next socket call
+      if(fds[0].revents != 0)
+        return Wait::Ready;
+      if(fds[2].revents != 0)
+      {
+        m_timer.acknowledge();
+        return Wait::Timeout;
+      }
+      if(r == 0)
+        return Wait::Timeout;
+    }
+  }
+
+  void handleDisconnect()
+  {
+    if(m_state == State::Connected && !m_stopped)
+      qDebug() << "Hyperion: Disconnected, reconnecting";
+
+    for(auto* link : m_links)
+    {
+      link->setConnected(false);
+      if(link->m_mailbox.discard())
+        link->countDropped();
+    }
+
+    closeSocket();
+    scheduleRetry();
+  }
+
+  void closeSocket()
+  {
+    if(m_socket >= 0)
+    {
+      if(m_zeroCopy.pending() > 0)
+        m_zeroCopy.drain(m_socket, zeroCopyDrainTimeout);
+      ::close(m_socket);
+      m_socket = -1;
+    }
+    m_zeroCopy.reset();
+    m_pendingReplies.clear();
+    m_registeredPriority = -1;
+  }
+
+  OutputTarget m_target;
+  int m_socket{-1};
+  int m_wakePipe[2]{-1, -1};
+  std::atomic_bool m_stopped{false};
+
+  // Links joining and leaving, applied by the sender thread
+  std::mutex m_membersMutex;
+  std::vector<HyperionLinkImpl*> m_attaching;
+  std::vector<std::shared_ptr<HyperionLinkImpl>> m_detaching;
+  std::atomic_bool m_membersChanged{false};
+
+  // Posts since the start, and whether the sender thread waits for one
+  std::atomic<uint64_t> m_posts{};
+  std::atomic_bool m_idle{false};
+
+  // Sender thread connection state
+  State m_state{State::Disconnected};
+  clock::time_point m_retryAt{};
+  clock::time_point m_connectDeadline{};
+  std::chrono::milliseconds m_backoff{initialBackoff};
+  int m_failures{};
+
+  std::vector<HyperionLinkImpl*> m_links;
+  std::size_t m_cursor{}; // Last link served
+  HyperionLinkImpl* m_sending{};
+  // Registration the images and colors currently apply to, -1 before the first one
+  int m_registeredPriority{-1};
+  std::string m_registeredOrigin;
+  uint64_t m_bytesWritten{};
+
+  // Replies and flow control
+  ReplyReader m_replies;
+  RingQueue<PendingReply> m_pendingReplies;
+  bool m_repliesMissing{}; // The peer does not reply, requests are not tracked anymore
+  int m_replyErrors{};
+
+  PacingTimer m_timer;
+  EncodedFrame m_control; // Register / Clear messages
+  ZeroCopyTracker m_zeroCopy;
+  bool m_zeroCopyTried{};
+  bool m_zeroCopyWarned{};
+  std::minstd_rand m_rng;
+  std::thread m_thread;
+};
+
+HyperionLinkImpl::HyperionLinkImpl(
+    const OutputSettings& settings, const OutputTarget& target,
+    std::shared_ptr<Metrics> metrics, std::size_t index,
+    std::shared_ptr<StreamRecorder> recorder, HyperionSocket& socket)
+    : m_settings{settings}
+    , m_target{target}
+    , m_origin{settings.origin.toStdString()}
+    , m_metrics{std::move(metrics)}
+    , m_targetMetrics{m_metrics->target(index)}
+    , m_recorder{std::move(recorder)}
+    , m_socket{socket}
+{
+}
+
+void HyperionLinkImpl::post(std::shared_ptr<const EncodedFrame> frame)
+{
+  if(!frame || !m_connected)
+  {
+    countDropped();
+    return;
+  }
+
+  if(m_mailbox.post(std::move(frame)))
+  {
+    m_superseded.fetch_add(1, std::memory_order_relaxed);
+    m_metrics->superseded.fetch_add(1, std::memory_order_relaxed);
+  }
+  m_socket.notifyPosted();
+}
+
+// Public interface
+
+HyperionLink::HyperionLink(
+    const OutputSettings& settings, const OutputTarget& target,
+    std::shared_ptr<Metrics> metrics, std::size_t index,
+    std::shared_ptr<StreamRecorder> recorder)
+    : m_socket{HyperionSocket::get(target)}
+    , m_impl{std::make_shared<HyperionLinkImpl>(
+          settings, target, std::move(metrics), index, std::move(recorder), *m_socket)}
+{
+  m_socket->attach(m_impl.get());
+}
+
+HyperionLink::~HyperionLink()
+{
+  m_socket->detach(std::move(m_impl));
+}
+
+const OutputTarget& HyperionLink::target() const noexcept
+{
+  return m_impl->target();
+}
+
+bool HyperionLink::isConnected() const
+{
+  return m_impl->isConnected();
+}
+
+uint32_t HyperionLink::generation() const
+{
+  return m_impl->generation();
+}
+
+std::chrono::steady_clock::time_point HyperionLink::nextSendAt() const
+{
+  return m_impl->nextSendAt();
+}
+
+void HyperionLink::post(std::shared_ptr<const EncodedFrame> frame)
+{
+  m_impl->post(std::move(frame));
+}
+
+ConnectionStatistics HyperionLink::statistics() const
+{
+  return m_impl->statistics();
+}
+
+}
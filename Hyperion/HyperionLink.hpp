@@ -0,0 +1,61 @@
+#pragma once
+#include "HyperionConnection.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Hyperion
+{
+struct EncodedFrame;
+struct Metrics;
+struct OutputSettings;
+struct OutputTarget;
+class StreamRecorder;
+
+class HyperionLinkImpl;
+class HyperionSocket;
+
+// Stream of one output to one Hyperion instance, with its own pacing and
+// congestion control. The links to the same address, from any output of the
+// process, share one socket, sender thread and reconnection, and take turns.
+class HyperionLink
+{
+public:
+  // `metrics` is shared with the other links, `recorder` gets every message
+  // sent when given. `index` is the one of the target in settings.targets(),
+  // for its metrics.
+  HyperionLink(
+      const OutputSettings& settings, const OutputTarget& target,
+      std::shared_ptr<Metrics> metrics, std::size_t index = 0,
+      std::shared_ptr<StreamRecorder> recorder = {});
+
+  // Does not wait for the network: the socket's sender thread sends the
+  // Clear if needed and releases the link's state afterwards
+  ~HyperionLink();
+
+  HyperionLink(const HyperionLink&) = delete;
+  HyperionLink& operator=(const HyperionLink&) = delete;
+
+  const OutputTarget& target() const noexcept;
+  bool isConnected() const;
+
+  // Incremented on every new connection
+  uint32_t generation() const;
+
+  // Time of the next send while sends are paced, a default time point when
+  // frames are sent as they come. Updated by the sender thread.
+  std::chrono::steady_clock::time_point nextSendAt() const;
+
+  // Called from the render thread, the frame may be shared with other links.
+  // A null frame only counts as dropped for this target.
+  void post(std::shared_ptr<const EncodedFrame> frame);
+
+  ConnectionStatistics statistics() const;
+
+private:
+  std::shared_ptr<HyperionSocket> m_socket;
+  std::shared_ptr<HyperionLinkImpl> m_impl;
+};
+}
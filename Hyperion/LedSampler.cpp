@@ -0,0 +1,124 @@
+#include "LedSampler.hpp"
+#include "OutputSettings.hpp"
+#include "PixelConversion.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Hyperion
+{
+LedSampler::LedSampler(const OutputSettings& settings)
+    : m_top{std::max(settings.ledTop, 0)}
+    , m_right{std::max(settings.ledRight, 0)}
+    , m_bottom{std::max(settings.ledBottom, 0)}
+    , m_left{std::max(settings.ledLeft, 0)}
+    , m_depth{std::clamp(settings.ledDepth, 1, 50)}
+{
+  m_ledCount = m_top + m_right + m_bottom + m_left;
+  if(m_ledCount == 0)
+    return;
+
+  // At least two columns and rows so that opposite edges do not share pixels
+  m_cols = std::max({m_top, m_bottom, 2});
+  m_rows = std::max({m_left, m_right, 2});
+
+  // Every pixel shows the LED of the nearest edge which has some.
+  // Corners go to the top and bottom edges, like Hyperion's classic layout.
+  m_pixelLed.resize(std::size_t(m_cols) * m_rows);
+  for(int y = 0; y < m_rows; y++)
+  {
+    for(int x = 0; x < m_cols; x++)
+    {
+      int best = -1;
+      int bestDistance = m_cols + m_rows;
+      auto consider = [&](int count, int distance, int led) {
+        if(count > 0 && distance < bestDistance)
+        {
+          bestDistance = distance;
+          best = led;
+        }
+      };
+
+      // LEDs are numbered clockwise from the top-left corner
+      consider(m_top, y, x * m_top / m_cols);
+      consider(m_bottom, m_rows - 1 - y, m_top + m_right + m_bottom - 1 - x * m_bottom / m_cols);
+      consider(m_left, x, m_top + m_right + m_bottom + m_left - 1 - y * m_left / m_rows);
+      consider(m_right, m_cols - 1 - x, m_top + y * m_right / m_rows);
+      m_pixelLed[std::size_t(y) * m_cols + x] = uint16_t(best);
+    }
+  }
+
+  m_regions.resize(m_ledCount);
+  m_colors.resize(std::size_t(m_ledCount) * 4);
+  m_image.resize(std::size_t(m_cols) * m_rows * 4);
+}
+
+void LedSampler::configure(int width, int height)
+{
+  m_frameWidth = width;
+  m_frameHeight = height;
+
+  const int dw = std::max(1, width * m_depth / 100);
+  const int dh = std::max(1, height * m_depth / 100);
+
+  // Segment i of n along a side of `length` pixels, never empty
+  auto segment = [](int i, int n, int length) {
+    const int a = std::min(i * length / n, length - 1);
+    const int b = std::max((i + 1) * length / n, a + 1);
+    return std::pair{a, b};
+  };
+
+  int led = 0;
+  for(int i = 0; i < m_top; i++)
+  {
+    const auto [a, b] = segment(i, m_top, width);
+    m_regions[led++] = {a, 0, b, dh};
+  }
+  for(int i = 0; i < m_right; i++)
+  {
+    const auto [a, b] = segment(i, m_right, height);
+    m_regions[led++] = {width - dw, a, width, b};
+  }
+  for(int i = m_bottom - 1; i >= 0; i--)
+  {
+    const auto [a, b] = segment(i, m_bottom, width);
+    m_regions[led++] = {a, height - dh, b, height};
+  }
+  for(int i = m_left - 1; i >= 0; i--)
+  {
+    const auto [a, b] = segment(i, m_left, height);
+    m_regions[led++] = {0, a, dw, b};
+  }
+}
+
+void LedSampler::sample(const uint8_t* rgba, int width, int height)
+{
+  if(!enabled() || width <= 0 || height <= 0)
+    return;
+
+  if(width != m_frameWidth || height != m_frameHeight)
+    configure(width, height);
+
+  const std::size_t stride = std::size_t(width) * 4;
+  for(int led = 0; led < m_ledCount; led++)
+  {
+    const auto& r = m_regions[led];
+    uint64_t sums[4]{};
+    for(int y = r.y0; y < r.y1; y++)
+      sumRgba(rgba + y * stride + std::size_t(r.x0) * 4, r.x1 - r.x0, sums);
+
+    const uint64_t count = uint64_t(r.x1 - r.x0) * uint64_t(r.y1 - r.y0);
+    uint8_t* color = m_colors.data() + std::size_t(led) * 4;
+    for(int c = 0; c < 3; c++)
+      color[c] = uint8_t((sums[c] + count / 2) / count);
+    color[3] = 255;
+  }
+
+  uint8_t* dst = m_image.data();
+  for(uint16_t led : m_pixelLed)
+  {
+    std::memcpy(dst, m_colors.data() + std::size_t(led) * 4, 4);
+    dst += 4;
+  }
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Hyperion
+{
+struct OutputSettings;
+
+// Reduces a frame to what an ambilight-style LED layout sees: every LED gets
+// the average color of its segment of the border, over `depth` percent of the
+// frame. The result is a small RGBA image with one pixel per LED along each
+// edge, in which every inner pixel repeats the nearest edge, so Hyperion's
+// classic layout with the same LED counts samples exactly these colors.
+class LedSampler
+{
+public:
+  explicit LedSampler(const OutputSettings& settings);
+
+  // False when no LED count is set, frames are then sent as they are
+  bool enabled() const noexcept { return m_ledCount > 0; }
+
+  // Render thread. `rgba` is width x height, the regions are recomputed
+  // whenever the size changes.
+  void sample(const uint8_t* rgba, int width, int height);
+
+  const uint8_t* data() const noexcept { return m_image.data(); }
+  int width() const noexcept { return m_cols; }
+  int height() const noexcept { return m_rows; }
+
+private:
+  struct Region
+  {
+    int x0, y0, x1, y1;
+  };
+
+  void configure(int width, int height);
+
+  int m_top{}, m_right{}, m_bottom{}, m_left{};
+  int m_depth{};
+  int m_ledCount{};
+  int m_cols{}, m_rows{};
+
+  // Size of the frame the regions were computed for
+  int m_frameWidth{}, m_frameHeight{};
+
+  // One region and one RGBA color per LED, clockwise from the top-left corner
+  std::vector<Region> m_regions;
+  std::vector<uint8_t> m_colors;
+  // LED shown by each pixel of the output image
+  std::vector<uint16_t> m_pixelLed;
+  std::vector<uint8_t> m_image;
+};
+}
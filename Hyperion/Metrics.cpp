@@ -0,0 +1,49 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace Hyperion
+{
+int LatencyHistogram::bucketIndex(int64_t us) noexcept
+{
+  if(us < 1)
+    return 0;
+
+  // Octave from the position of the highest bit, quarter from the two bits below it
+  const auto v = uint64_t(us);
+  const int octave = std::bit_width(v) - 1;
+  const int quarter = octave >= 2 ? int((v >> (octave - 2)) & 3) : int(v << (2 - octave)) & 3;
+  return std::min(1 + octave * 4 + quarter, bucketCount - 1);
+}
+
+double LatencyHistogram::bucketUpperBound(int index) noexcept
+{
+  if(index <= 0)
+    return 0.001;
+
+  const int octave = (index - 1) / 4;
+  const int quarter = (index - 1) % 4;
+  return std::ldexp(1. + (quarter + 1) / 4., octave) / 1000.;
+}
+
+double LatencyHistogram::percentile(const Buckets& buckets, double p) noexcept
+{
+  uint64_t total = 0;
+  for(auto n : buckets)
+    total += n;
+  if(total == 0)
+    return 0.;
+
+  const auto rank = uint64_t(std::ceil(p * double(total)));
+  uint64_t seen = 0;
+  for(int i = 0; i < bucketCount; i++)
+  {
+    seen += buckets[i];
+    if(seen >= std::max<uint64_t>(rank, 1))
+      return bucketUpperBound(i);
+  }
+  return bucketUpperBound(bucketCount - 1);
+}
+}
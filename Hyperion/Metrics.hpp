@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Hyperion
+{
+// Histogram of durations with logarithmic buckets (4 per octave from 1 µs),
+// filled lock-free from any thread. A single reader collects it periodically.
+class LatencyHistogram
+{
+public:
+  static constexpr int bucketCount = 96;
+  using Buckets = std::array<uint32_t, bucketCount>;
+
+  void record(std::chrono::steady_clock::duration d) noexcept
+  {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    m_buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Moves the counts recorded since the previous call into `out`
+  void collect(Buckets& out) noexcept
+  {
+    for(int i = 0; i < bucketCount; i++)
+      out[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+  }
+
+  // Upper bound of the bucket holding the p-th quantile, in ms, 0 if empty
+  static double percentile(const Buckets& buckets, double p) noexcept;
+
+  static int bucketIndex(int64_t us) noexcept;
+  static double bucketUpperBound(int index) noexcept;
+
+private:
+  std::array<std::atomic<uint32_t>, bucketCount> m_buckets{};
+};
+
+// Counters of the stream to one Hyperion instance
+struct TargetMetrics
+{
+  std::atomic_bool connected{};
+  std::atomic<uint64_t> sent{};
+  std::atomic<uint64_t> dropped{};
+  // Frames per second allowed by congestion control, up to the send rate
+  std::atomic<double> sendRate{};
+};
+
+// Counters shared between the output device, which publishes them,
+// and the render and sender threads, which update them.
+// Frames are counted once however many targets they go to.
+struct Metrics
+{
+  explicit Metrics(std::size_t targetCount = 1)
+      : targets(targetCount)
+  {
+  }
+
+  // Sent to at least one target
+  std::atomic<uint64_t> sent{};
+  // Rendered while no target was connected
+  std::atomic<uint64_t> dropped{};
+  // Replaced in a mailbox by a newer frame before being sent
+  std::atomic<uint64_t> superseded{};
+  std::atomic<uint64_t> deduplicated{};
+  std::atomic<uint64_t> colors{};
+  std::atomic<uint64_t> bytesSent{};
+  // Frames rendered while every readback buffer was still in flight
+  std::atomic<uint64_t> readbackOverruns{};
+  std::atomic<int> connectedTargets{};
+
+  LatencyHistogram conversion;
+  LatencyHistogram serialization;
+  LatencyHistogram send;
+  // Deviation of the paced send intervals from the target one
+  LatencyHistogram sendJitter;
+  // From the end of the frame's render to the end of its send
+  LatencyHistogram latency;
+
+  // In the order of OutputSettings::targets()
+  std::vector<TargetMetrics> targets;
+
+  TargetMetrics* target(std::size_t index) noexcept
+  {
+    return index < targets.size() ? &targets[index] : nullptr;
+  }
+};
+}
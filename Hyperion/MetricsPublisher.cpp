@@ -0,0 +1,148 @@
+#include "MetricsPublisher.hpp"
+#include "OutputSettings.hpp"
+
+#include <ossia/network/base/node.hpp>
+#include <ossia/network/base/parameter.hpp>
+#include <ossia/network/generic/generic_node.hpp>
+
+namespace Hyperion
+{
+namespace
+{
+constexpr auto updateInterval = std::chrono::milliseconds{500};
+
+ossia::net::node_base& makeNode(ossia::net::node_base& parent, const std::string& name)
+{
+  return *parent.add_child(
+      std::make_unique<ossia::net::generic_node>(name, parent.get_device(), parent));
+}
+
+ossia::net::parameter_base*
+makeParameter(ossia::net::node_base& parent, const std::string& name, ossia::val_type type)
+{
+  auto param = makeNode(parent, name).create_parameter(type);
+  param->set_access(ossia::access_mode::GET);
+  return param;
+}
+
+void publishPercentiles(
+    ossia::net::parameter_base* const (&params)[2], LatencyHistogram& histogram)
+{
+  LatencyHistogram::Buckets buckets;
+  histogram.collect(buckets);
+
+  // Keep the last values when nothing was measured during the interval
+  if(LatencyHistogram::percentile(buckets, 1.) == 0.)
+    return;
+
+  params[0]->push_value(float(LatencyHistogram::percentile(buckets, 0.5)));
+  params[1]->push_value(float(LatencyHistogram::percentile(buckets, 0.99)));
+}
+}
+
+MetricsPublisher::MetricsPublisher(
+    ossia::net::node_base& parent, std::shared_ptr<Metrics> metrics,
+    const std::vector<OutputTarget>& targets)
+    : m_metrics{std::move(metrics)}
+{
+  using ossia::val_type;
+  auto& root = makeNode(parent, "metrics");
+
+  m_connected = makeParameter(root, "connected", val_type::BOOL);
+  m_connectedTargets = makeParameter(root, "connected_targets", val_type::INT);
+  m_sent = makeParameter(root, "sent", val_type::INT);
+  m_dropped = makeParameter(root, "dropped", val_type::INT);
+  m_superseded = makeParameter(root, "superseded", val_type::INT);
+  m_deduplicated = makeParameter(root, "deduplicated", val_type::INT);
+  m_colors = makeParameter(root, "colors", val_type::INT);
+  m_readbackOverruns = makeParameter(root, "readback_overruns", val_type::INT);
+  m_bytesPerSecond = makeParameter(root, "bytes_per_second", val_type::FLOAT);
+  m_fps = makeParameter(root, "fps", val_type::FLOAT);
+  m_sendRate = makeParameter(root, "send_rate", val_type::FLOAT);
+
+  // Times in milliseconds over the last update interval
+  m_conversion[0] = makeParameter(root, "conversion_p50", val_type::FLOAT);
+  m_conversion[1] = makeParameter(root, "conversion_p99", val_type::FLOAT);
+  m_serialization[0] = makeParameter(root, "serialize_p50", val_type::FLOAT);
+  m_serialization[1] = makeParameter(root, "serialize_p99", val_type::FLOAT);
+  m_send[0] = makeParameter(root, "send_p50", val_type::FLOAT);
+  m_send[1] = makeParameter(root, "send_p99", val_type::FLOAT);
+  m_sendJitter[0] = makeParameter(root, "send_jitter_p50", val_type::FLOAT);
+  m_sendJitter[1] = makeParameter(root, "send_jitter_p99", val_type::FLOAT);
+  m_latency[0] = makeParameter(root, "latency_p50", val_type::FLOAT);
+  m_latency[1] = makeParameter(root, "latency_p99", val_type::FLOAT);
+
+  // Which instance each node is about does not change
+  auto& targetsNode = makeNode(root, "targets");
+  for(std::size_t i = 0; i < targets.size() && i < m_metrics->targets.size(); i++)
+  {
+    auto& node = makeNode(targetsNode, std::to_string(i));
+    makeParameter(node, "address", val_type::STRING)->push_value(targets[i].name().toStdString());
+    makeParameter(node, "priority", val_type::INT)->push_value(targets[i].priority);
+    m_targets.push_back(
+        {.connected = makeParameter(node, "connected", val_type::BOOL),
+         .sent = makeParameter(node, "sent", val_type::INT),
+         .dropped = makeParameter(node, "dropped", val_type::INT),
+         .sendRate = makeParameter(node, "send_rate", val_type::FLOAT)});
+  }
+
+  m_lastUpdate = std::chrono::steady_clock::now();
+  QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this] { update(); });
+  m_timer.start(updateInterval);
+}
+
+MetricsPublisher::~MetricsPublisher()
+{
+  m_timer.stop();
+}
+
+void MetricsPublisher::update()
+{
+  auto& m = *m_metrics;
+  const auto now = std::chrono::steady_clock::now();
+  const double dt = std::chrono::duration<double>(now - m_lastUpdate).count();
+  m_lastUpdate = now;
+
+  const uint64_t sent = m.sent.load(std::memory_order_relaxed);
+  const uint64_t bytes = m.bytesSent.load(std::memory_order_relaxed);
+  const int connectedTargets = m.connectedTargets.load(std::memory_order_relaxed);
+
+  m_connected->push_value(connectedTargets > 0);
+  m_connectedTargets->push_value(connectedTargets);
+  m_sent->push_value(int(sent));
+  m_dropped->push_value(int(m.dropped.load(std::memory_order_relaxed)));
+  m_superseded->push_value(int(m.superseded.load(std::memory_order_relaxed)));
+  m_deduplicated->push_value(int(m.deduplicated.load(std::memory_order_relaxed)));
+  m_colors->push_value(int(m.colors.load(std::memory_order_relaxed)));
+  m_readbackOverruns->push_value(int(m.readbackOverruns.load(std::memory_order_relaxed)));
+  if(dt > 0.)
+  {
+    m_bytesPerSecond->push_value(float((bytes - m_lastBytes) / dt));
+    m_fps->push_value(float((sent - m_lastSent) / dt));
+  }
+  m_lastSent = sent;
+  m_lastBytes = bytes;
+
+  publishPercentiles(m_conversion, m.conversion);
+  publishPercentiles(m_serialization, m.serialization);
+  publishPercentiles(m_send, m.send);
+  publishPercentiles(m_sendJitter, m.sendJitter);
+  publishPercentiles(m_latency, m.latency);
+
+  // The slowest connected target sets the pace of the frames they share
+  double sendRate = 0.;
+  for(std::size_t i = 0; i < m_targets.size(); i++)
+  {
+    const auto& t = m.targets[i];
+    const bool connected = t.connected.load(std::memory_order_relaxed);
+    const double rate = t.sendRate.load(std::memory_order_relaxed);
+    m_targets[i].connected->push_value(connected);
+    m_targets[i].sent->push_value(int(t.sent.load(std::memory_order_relaxed)));
+    m_targets[i].dropped->push_value(int(t.dropped.load(std::memory_order_relaxed)));
+    m_targets[i].sendRate->push_value(float(connected ? rate : 0.));
+    if(connected && (sendRate == 0. || rate < sendRate))
+      sendRate = rate;
+  }
+  m_sendRate->push_value(float(sendRate));
+}
+}
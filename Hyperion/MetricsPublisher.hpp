@@ -0,0 +1,70 @@
+#pragma once
+#include <Hyperion/Metrics.hpp>
+
+#include <QTimer>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace ossia::net
+{
+class node_base;
+class parameter_base;
+}
+
+namespace Hyperion
+{
+struct OutputTarget;
+
+// Exposes the Metrics as read-only parameters under a "metrics" node of the
+// device, refreshed from the main thread by polling the atomic counters.
+// Each target gets its own node under "metrics/targets", by index.
+class MetricsPublisher
+{
+public:
+  MetricsPublisher(
+      ossia::net::node_base& parent, std::shared_ptr<Metrics> metrics,
+      const std::vector<OutputTarget>& targets);
+  ~MetricsPublisher();
+
+  MetricsPublisher(const MetricsPublisher&) = delete;
+  MetricsPublisher& operator=(const MetricsPublisher&) = delete;
+
+private:
+  struct TargetParameters
+  {
+    ossia::net::parameter_base* connected{};
+    ossia::net::parameter_base* sent{};
+    ossia::net::parameter_base* dropped{};
+    ossia::net::parameter_base* sendRate{};
+  };
+
+  void update();
+
+  std::shared_ptr<Metrics> m_metrics;
+  QTimer m_timer;
+
+  ossia::net::parameter_base* m_connected{};
+  ossia::net::parameter_base* m_connectedTargets{};
+  ossia::net::parameter_base* m_sent{};
+  ossia::net::parameter_base* m_dropped{};
+  ossia::net::parameter_base* m_superseded{};
+  ossia::net::parameter_base* m_deduplicated{};
+  ossia::net::parameter_base* m_colors{};
+  ossia::net::parameter_base* m_readbackOverruns{};
+  ossia::net::parameter_base* m_bytesPerSecond{};
+  ossia::net::parameter_base* m_fps{};
+  ossia::net::parameter_base* m_sendRate{};
+  ossia::net::parameter_base* m_conversion[2]{};
+  ossia::net::parameter_base* m_serialization[2]{};
+  ossia::net::parameter_base* m_send[2]{};
+  ossia::net::parameter_base* m_sendJitter[2]{};
+  ossia::net::parameter_base* m_latency[2]{};
+  std::vector<TargetParameters> m_targets;
+
+  std::chrono::steady_clock::time_point m_lastUpdate{};
+  uint64_t m_lastSent{};
+  uint64_t m_lastBytes{};
+};
+}
@@ -2,7 +2,9 @@
 
 #include <State/Widgets/AddressFragmentLineEdit.hpp>
 
+#include <QCheckBox>
 #include <QComboBox>
+#include <QDoubleSpinBox>
 #include <QFormLayout>
 #include <QLabel>
 #include <QSpinBox>
@@ -39,6 +41,142 @@ public:
     m_origin->setText("ossia score");
     m_layout->addRow(tr("Origin"), m_origin);
 
+    m_localSocket = new QLineEdit{this};
+    m_localSocket->setPlaceholderText(tr("None, use TCP"));
+    m_localSocket->setToolTip(
+        tr("Unix domain socket of a Hyperion running on this machine, replaces host and port"));
+    m_layout->addRow(tr("Local socket"), m_localSocket);
+
+    m_sendRate = new QDoubleSpinBox{this};
+    m_sendRate->setRange(0., 240.);
+    m_sendRate->setDecimals(1);
+    m_sendRate->setSuffix(" fps");
+    m_sendRate->setSpecialValueText(tr("Render rate"));
+    m_sendRate->setToolTip(
+        tr("Rate at which the newest rendered frame is sent, lower than the render rate "
+           "to spare the network and Hyperion"));
+    m_layout->addRow(tr("Send rate"), m_sendRate);
+
+    m_sendWidth = new QSpinBox{this};
+    m_sendWidth->setRange(0, 16384);
+    m_sendWidth->setSpecialValueText(tr("Full"));
+    m_layout->addRow(tr("Send width"), m_sendWidth);
+
+    m_sendHeight = new QSpinBox{this};
+    m_sendHeight->setRange(0, 16384);
+    m_sendHeight->setSpecialValueText(tr("Full"));
+    m_layout->addRow(tr("Send height"), m_sendHeight);
+
+    m_deduplicate = new QCheckBox{this};
+    m_deduplicate->setChecked(true);
+    m_deduplicate->setToolTip(tr("Do not re-send frames identical to the previous one"));
+    m_layout->addRow(tr("Skip identical frames"), m_deduplicate);
+
+    m_keepAlive = new QSpinBox{this};
+    m_keepAlive->setRange(0, 60000);
+    m_keepAlive->setSuffix(" ms");
+    m_keepAlive->setSpecialValueText(tr("Never"));
+    m_keepAlive->setToolTip(tr("Interval at which a skipped frame is sent again"));
+    m_layout->addRow(tr("Keep-alive"), m_keepAlive);
+
+    m_colorTolerance = new QSpinBox{this};
+    m_colorTolerance->setRange(-1, 255);
+    m_colorTolerance->setSpecialValueText(tr("Off"));
+    m_colorTolerance->setToolTip(
+        tr("Frames of a single color, within this tolerance per channel, are sent as a color "
+           "instead of an image"));
+    m_layout->addRow(tr("Solid color tolerance"), m_colorTolerance);
+
+    m_brightness = new QSpinBox{this};
+    m_brightness->setRange(0, 100);
+    m_brightness->setSuffix(" %");
+    m_brightness->setToolTip(tr("LED brightness, applied while converting the frames"));
+    m_layout->addRow(tr("Brightness"), m_brightness);
+
+    m_gamma = new QDoubleSpinBox{this};
+    m_gamma->setRange(0.1, 5.);
+    m_gamma->setSingleStep(0.1);
+    m_gamma->setToolTip(
+        tr("LED gamma correction, 1 for none. Hyperion's own gamma can then be set to 1"));
+    m_layout->addRow(tr("Gamma"), m_gamma);
+
+    // Red, green, blue
+    const QString whites[]{tr("White balance red"), tr("White balance green"),
+                           tr("White balance blue")};
+    for(int i = 0; i < 3; i++)
+    {
+      m_whiteBalance[i] = new QSpinBox{this};
+      m_whiteBalance[i]->setRange(0, 100);
+      m_whiteBalance[i]->setSuffix(" %");
+      m_layout->addRow(whites[i], m_whiteBalance[i]);
+    }
+
+    // Top, right, bottom, left
+    const QString edges[]{tr("LEDs top"), tr("LEDs right"), tr("LEDs bottom"), tr("LEDs left")};
+    for(int i = 0; i < 4; i++)
+    {
+      m_ledCounts[i] = new QSpinBox{this};
+      m_ledCounts[i]->setRange(0, 1000);
+      m_ledCounts[i]->setSpecialValueText(tr("None"));
+      m_ledCounts[i]->setToolTip(
+          tr("With an LED layout, only one averaged color per LED is sent instead of the frame"));
+      m_layout->addRow(edges[i], m_ledCounts[i]);
+    }
+
+    m_ledDepth = new QSpinBox{this};
+    m_ledDepth->setRange(1, 50);
+    m_ledDepth->setSuffix(" %");
+    m_ledDepth->setToolTip(tr("Depth of the border averaged for each LED"));
+    m_layout->addRow(tr("LED border depth"), m_ledDepth);
+
+    m_conversionThreads = new QSpinBox{this};
+    m_conversionThreads->setRange(0, 16);
+    m_conversionThreads->setSpecialValueText(tr("Auto"));
+    m_conversionThreads->setToolTip(
+        tr("Threads converting large frames, smaller ones stay on the render thread"));
+    m_layout->addRow(tr("Conversion threads"), m_conversionThreads);
+
+    m_maxInFlight = new QSpinBox{this};
+    m_maxInFlight->setRange(0, 64);
+    m_maxInFlight->setSpecialValueText(tr("Unlimited"));
+    m_maxInFlight->setToolTip(
+        tr("Frames sent before Hyperion must acknowledge them, bounds the latency"));
+    m_layout->addRow(tr("Max frames in flight"), m_maxInFlight);
+
+    m_zeroCopy = new QCheckBox{this};
+    m_zeroCopy->setToolTip(
+        tr("Linux: send large frames without copying them into the kernel, "
+           "useful for high resolutions to a remote Hyperion"));
+    m_layout->addRow(tr("Zero-copy send"), m_zeroCopy);
+
+    m_readbackDepth = new QSpinBox{this};
+    m_readbackDepth->setRange(1, 8);
+    m_readbackDepth->setToolTip(
+        tr("Frames which can be read back from the GPU at the same time"));
+    m_layout->addRow(tr("Readback buffers"), m_readbackDepth);
+
+    m_lowLatency = new QCheckBox{tr("Low latency"), this};
+    m_lowLatency->setToolTip(
+        tr("Send each frame as soon as its readback completes instead of after the frame"));
+    m_layout->addRow(tr("Readback mode"), m_lowLatency);
+
+    m_headless = new QCheckBox{tr("Headless"), this};
+    m_headless->setToolTip(
+        tr("Render without a GPU and send synthetic frames, to benchmark the pipeline"));
+    m_layout->addRow(tr("Graphics"), m_headless);
+
+    m_captureFile = new QLineEdit{this};
+    m_captureFile->setPlaceholderText(tr("None"));
+    m_captureFile->setToolTip(
+        tr("Records the messages sent to Hyperion to this file, to replay them later"));
+    m_layout->addRow(tr("Capture file"), m_captureFile);
+
+    m_extraTargets = new QLineEdit{this};
+    m_extraTargets->setPlaceholderText("192.168.1.20:19400/100, 192.168.1.21");
+    m_extraTargets->setToolTip(
+        tr("Other Hyperion instances receiving the same frames, as host[:port][/priority]"));
+    m_layout->addRow(tr("Additional targets"), m_extraTargets);
+
     setSettings(OutputFactory{}.defaultSettings());
   }
 
@@ -51,9 +189,34 @@ public:
     m_port->setValue(set.port);
     m_priority->setValue(set.priority);
     m_origin->setText(set.origin);
+    m_localSocket->setText(set.localSocket);
     m_width->setValue(set.width);
     m_height->setValue(set.height);
     m_rate->setValue(set.rate);
+    m_sendRate->setValue(set.sendRate);
+    m_sendWidth->setValue(set.sendWidth);
+    m_sendHeight->setValue(set.sendHeight);
+    m_deduplicate->setChecked(set.deduplicate);
+    m_keepAlive->setValue(set.keepAlive);
+    m_colorTolerance->setValue(set.colorTolerance);
+    m_brightness->setValue(set.brightness);
+    m_gamma->setValue(set.gamma);
+    m_whiteBalance[0]->setValue(set.whiteRed);
+    m_whiteBalance[1]->setValue(set.whiteGreen);
+    m_whiteBalance[2]->setValue(set.whiteBlue);
+    m_ledCounts[0]->setValue(set.ledTop);
+    m_ledCounts[1]->setValue(set.ledRight);
+    m_ledCounts[2]->setValue(set.ledBottom);
+    m_ledCounts[3]->setValue(set.ledLeft);
+    m_ledDepth->setValue(set.ledDepth);
+    m_conversionThreads->setValue(set.conversionThreads);
+    m_maxInFlight->setValue(set.maxInFlight);
+    m_extraTargets->setText(set.extraTargets);
+    m_zeroCopy->setChecked(set.zeroCopy);
+    m_readbackDepth->setValue(set.readbackDepth);
+    m_lowLatency->setChecked(set.lowLatency);
+    m_headless->setChecked(set.headless);
+    m_captureFile->setText(set.captureFile);
   }
 
   Device::DeviceSettings getSettings() const override
@@ -67,9 +230,34 @@ public:
         .port = m_port->value(),
         .priority = m_priority->value(),
         .origin = m_origin->text(),
+        .localSocket = m_localSocket->text(),
         .width = base_s.width,
         .height = base_s.height,
-        .rate = base_s.rate};
+        .rate = base_s.rate,
+        .sendRate = m_sendRate->value(),
+        .sendWidth = m_sendWidth->value(),
+        .sendHeight = m_sendHeight->value(),
+        .deduplicate = m_deduplicate->isChecked(),
+        .keepAlive = m_keepAlive->value(),
+        .colorTolerance = m_colorTolerance->value(),
+        .brightness = m_brightness->value(),
+        .gamma = m_gamma->value(),
+        .whiteRed = m_whiteBalance[0]->value(),
+        .whiteGreen = m_whiteBalance[1]->value(),
+        .whiteBlue = m_whiteBalance[2]->value(),
+        .ledTop = m_ledCounts[0]->value(),
+        .ledRight = m_ledCounts[1]->value(),
+        .ledBottom = m_ledCounts[2]->value(),
+        .ledLeft = m_ledCounts[3]->value(),
+        .ledDepth = m_ledDepth->value(),
+        .conversionThreads = m_conversionThreads->value(),
+        .maxInFlight = m_maxInFlight->value(),
+        .zeroCopy = m_zeroCopy->isChecked(),
+        .readbackDepth = m_readbackDepth->value(),
+        .lowLatency = m_lowLatency->isChecked(),
+        .headless = m_headless->isChecked(),
+        .captureFile = m_captureFile->text(),
+        .extraTargets = m_extraTargets->text()};
 
     set.deviceSpecificSettings = QVariant::fromValue(std::move(specif));
     return set;
@@ -79,6 +267,26 @@ public:
   QSpinBox* m_port{};
   QSpinBox* m_priority{};
   QLineEdit* m_origin{};
+  QLineEdit* m_localSocket{};
+  QDoubleSpinBox* m_sendRate{};
+  QSpinBox* m_sendWidth{};
+  QSpinBox* m_sendHeight{};
+  QCheckBox* m_deduplicate{};
+  QSpinBox* m_keepAlive{};
+  QSpinBox* m_colorTolerance{};
+  QSpinBox* m_brightness{};
+  QDoubleSpinBox* m_gamma{};
+  QSpinBox* m_whiteBalance[3]{};
+  QSpinBox* m_ledCounts[4]{};
+  QSpinBox* m_ledDepth{};
+  QSpinBox* m_conversionThreads{};
+  QSpinBox* m_maxInFlight{};
+  QLineEdit* m_extraTargets{};
+  QCheckBox* m_zeroCopy{};
+  QSpinBox* m_readbackDepth{};
+  QCheckBox* m_lowLatency{};
+  QCheckBox* m_headless{};
+  QLineEdit* m_captureFile{};
 };
 
 Device::ProtocolSettingsWidget* OutputFactory::makeSettingsWidget()
@@ -140,6 +348,19 @@ void DataStreamReader::read(const Hyperion::OutputSettings& n)
 {
   m_stream << n.host << n.port << n.priority << n.origin;
   m_stream << n.width << n.height << n.rate;
+  m_stream << n.sendWidth << n.sendHeight;
+  m_stream << n.deduplicate << n.keepAlive;
+  m_stream << n.maxInFlight << n.extraTargets;
+  m_stream << n.readbackDepth << n.lowLatency;
+  m_stream << n.localSocket;
+  m_stream << n.colorTolerance;
+  m_stream << n.ledTop << n.ledRight << n.ledBottom << n.ledLeft << n.ledDepth;
+  m_stream << n.zeroCopy;
+  m_stream << n.conversionThreads;
+  m_stream << n.headless;
+  m_stream << n.sendRate;
+  m_stream << n.captureFile;
+  m_stream << n.brightness << n.gamma << n.whiteRed << n.whiteGreen << n.whiteBlue;
 }
 
 template <>
@@ -147,6 +368,19 @@ void DataStreamWriter::write(Hyperion::OutputSettings& n)
 {
   m_stream >> n.host >> n.port >> n.priority >> n.origin;
   m_stream >> n.width >> n.height >> n.rate;
+  m_stream >> n.sendWidth >> n.sendHeight;
+  m_stream >> n.deduplicate >> n.keepAlive;
+  m_stream >> n.maxInFlight >> n.extraTargets;
+  m_stream >> n.readbackDepth >> n.lowLatency;
+  m_stream >> n.localSocket;
+  m_stream >> n.colorTolerance;
+  m_stream >> n.ledTop >> n.ledRight >> n.ledBottom >> n.ledLeft >> n.ledDepth;
+  m_stream >> n.zeroCopy;
+  m_stream >> n.conversionThreads;
+  m_stream >> n.headless;
+  m_stream >> n.sendRate;
+  m_stream >> n.captureFile;
+  m_stream >> n.brightness >> n.gamma >> n.whiteRed >> n.whiteGreen >> n.whiteBlue;
 }
 
 template <>
@@ -159,6 +393,31 @@ void JSONReader::read(const Hyperion::OutputSettings& n)
   obj["Width"] = n.width;
   obj["Height"] = n.height;
   obj["Rate"] = n.rate;
+  obj["SendWidth"] = n.sendWidth;
+  obj["SendHeight"] = n.sendHeight;
+  obj["Deduplicate"] = n.deduplicate;
+  obj["KeepAlive"] = n.keepAlive;
+  obj["MaxInFlight"] = n.maxInFlight;
+  obj["ExtraTargets"] = n.extraTargets;
+  obj["ReadbackDepth"] = n.readbackDepth;
+  obj["LowLatency"] = n.lowLatency;
+  obj["LocalSocket"] = n.localSocket;
+  obj["ColorTolerance"] = n.colorTolerance;
+  obj["LedTop"] = n.ledTop;
+  obj["LedRight"] = n.ledRight;
+  obj["LedBottom"] = n.ledBottom;
+  obj["LedLeft"] = n.ledLeft;
+  obj["LedDepth"] = n.ledDepth;
+  obj["ZeroCopy"] = n.zeroCopy;
+  obj["ConversionThreads"] = n.conversionThreads;
+  obj["Headless"] = n.headless;
+  obj["SendRate"] = n.sendRate;
+  obj["CaptureFile"] = n.captureFile;
+  obj["Brightness"] = n.brightness;
+  obj["Gamma"] = n.gamma;
+  obj["WhiteRed"] = n.whiteRed;
+  obj["WhiteGreen"] = n.whiteGreen;
+  obj["WhiteBlue"] = n.whiteBlue;
 }
 
 template <>
@@ -171,4 +430,54 @@ void JSONWriter::write(Hyperion::OutputSettings& n)
   n.width = obj["Width"].toDouble();
   n.height = obj["Height"].toDouble();
   n.rate = obj["Rate"].toDouble();
+  if(auto v = obj.tryGet("SendWidth"))
+    n.sendWidth = v->toInt();
+  if(auto v = obj.tryGet("SendHeight"))
+    n.sendHeight = v->toInt();
+  if(auto v = obj.tryGet("Deduplicate"))
+    n.deduplicate = v->toBool();
+  if(auto v = obj.tryGet("KeepAlive"))
+    n.keepAlive = v->toInt();
+  if(auto v = obj.tryGet("MaxInFlight"))
+    n.maxInFlight = v->toInt();
+  if(auto v = obj.tryGet("ExtraTargets"))
+    n.extraTargets = v->toString();
+  if(auto v = obj.tryGet("ReadbackDepth"))
+    n.readbackDepth = v->toInt();
+  if(auto v = obj.tryGet("LowLatency"))
+    n.lowLatency = v->toBool();
+  if(auto v = obj.tryGet("LocalSocket"))
+    n.localSocket = v->toString();
+  if(auto v = obj.tryGet("ColorTolerance"))
+    n.colorTolerance = v->toInt();
+  if(auto v = obj.tryGet("LedTop"))
+    n.ledTop = v->toInt();
+  if(auto v = obj.tryGet("LedRight"))
+    n.ledRight = v->toInt();
+  if(auto v = obj.tryGet("LedBottom"))
+    n.ledBottom = v->toInt();
+  if(auto v = obj.tryGet("LedLeft"))
+    n.ledLeft = v->toInt();
+  if(auto v = obj.tryGet("LedDepth"))
+    n.ledDepth = v->toInt();
+  if(auto v = obj.tryGet("ZeroCopy"))
+    n.zeroCopy = v->toBool();
+  if(auto v = obj.tryGet("ConversionThreads"))
+    n.conversionThreads = v->toInt();
+  if(auto v = obj.tryGet("Headless"))
+    n.headless = v->toBool();
+  if(auto v = obj.tryGet("SendRate"))
+    n.sendRate = v->toDouble();
+  if(auto v = obj.tryGet("CaptureFile"))
+    n.captureFile = v->toString();
+  if(auto v = obj.tryGet("Brightness"))
+    n.brightness = v->toInt();
+  if(auto v = obj.tryGet("Gamma"))
+    n.gamma = v->toDouble();
+  if(auto v = obj.tryGet("WhiteRed"))
+    n.whiteRed = v->toInt();
+  if(auto v = obj.tryGet("WhiteGreen"))
+    n.whiteGreen = v->toInt();
+  if(auto v = obj.tryGet("WhiteBlue"))
+    n.whiteBlue = v->toInt();
 }
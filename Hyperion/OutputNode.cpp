@@ -11,10 +11,16 @@
 #include <QOffscreenSurface>
 #include <QTimer>
 #include <QtGui/private/qrhigles2_p.h>
+#include <QtGui/private/qrhinull_p.h>
 
+#include <Hyperion/DownscaleRenderer.hpp>
 #include <Hyperion/OutputNode.hpp>
 #include <Hyperion/OutputSettings.hpp>
 #include <Hyperion/HyperionConnection.hpp>
+#include <Hyperion/LedSampler.hpp>
+#include <Hyperion/Metrics.hpp>
+#include <Hyperion/MetricsPublisher.hpp>
+#include <Hyperion/ReadbackRing.hpp>
 
 #include <wobjectimpl.h>
 W_OBJECT_IMPL(Hyperion::OutputDevice)
@@ -25,7 +31,7 @@ struct OutputSettings;
 
 struct OutputNode : score::gfx::OutputNode
 {
-  OutputNode(const Hyperion::OutputSettings& set);
+  OutputNode(const Hyperion::OutputSettings& set, std::shared_ptr<Metrics> metrics);
   virtual ~OutputNode();
 
   // Non-copyable
@@ -39,8 +45,13 @@ struct OutputNode : score::gfx::OutputNode
   std::function<void()> m_update;
   std::shared_ptr<score::gfx::RenderState> m_renderState{};
   Gfx::InvertYRenderer* m_inv_y_renderer{};
-  QRhiReadbackResult m_readback[2];
-  QRhiReadbackResult* m_currentReadback{&m_readback[0]};
+  DownscaleRenderer* m_downscale_renderer{};
+  ReadbackRing m_readbacks;
+  LedSampler m_leds;
+  // Headless mode: frames standing in for the readbacks of the Null backend
+  std::vector<std::vector<uint8_t>> m_synthetic;
+  std::size_t m_syntheticIndex{};
+  std::shared_ptr<Metrics> m_metrics;
   std::unique_ptr<HyperionConnection> m_connection;
 
   void startRendering() override;
@@ -62,20 +73,29 @@ struct OutputNode : score::gfx::OutputNode
   createRenderer(score::gfx::RenderList& r) const noexcept override;
 
   Configuration configuration() const noexcept override;
+
+private:
+  QSize sendSize() const noexcept;
+  void sendReadback(const ReadbackRing::Slot& slot);
+  const uint8_t* syntheticFrame(int width, int height);
 };
 
 class hyperion_output_device : public ossia::net::device_base
 {
+  std::shared_ptr<Metrics> metrics;
   Gfx::gfx_node_base root;
+  MetricsPublisher publisher;
 
 public:
   hyperion_output_device(
       const Hyperion::OutputSettings& set,
       std::unique_ptr<ossia::net::protocol_base> proto, std::string name)
       : ossia::net::device_base{std::move(proto)}
+      , metrics{std::make_shared<Metrics>(set.targets().size())}
       , root{
             *this, *static_cast<Gfx::gfx_protocol_base*>(m_protocol.get()),
-            new OutputNode{set}, name}
+            new OutputNode{set, metrics}, name}
+      , publisher{root, metrics, set.targets()}
   {
   }
 
@@ -87,11 +107,22 @@ public:
   Gfx::gfx_node_base& get_root_node() override { return root; }
 };
 
-OutputNode::OutputNode(const Hyperion::OutputSettings& set)
+OutputNode::OutputNode(
+    const Hyperion::OutputSettings& set, std::shared_ptr<Metrics> metrics)
     : score::gfx::OutputNode{}
     , m_settings{set}
+    , m_leds{set}
+    , m_metrics{std::move(metrics)}
 {
   input.push_back(new score::gfx::Port{this, {}, score::gfx::Types::Image, {}});
+
+  // In low-latency mode frames are sent from QRhi's completion callback,
+  // as soon as their readback is done, instead of after the frame
+  if(m_settings.lowLatency)
+    m_readbacks.reset(
+        m_settings.readbackDepth, [this](ReadbackRing::Slot& slot) { sendReadback(slot); });
+  else
+    m_readbacks.reset(m_settings.readbackDepth);
 }
 
 OutputNode::~OutputNode()
@@ -106,7 +137,7 @@ bool OutputNode::canRender() const
 
 void OutputNode::startRendering() 
 {
-  m_connection = std::make_unique<HyperionConnection>(m_settings);
+  m_connection = std::make_unique<HyperionConnection>(m_settings, m_metrics);
 }
 
 void OutputNode::render()
@@ -118,38 +149,113 @@ void OutputNode::render()
   if(renderer && m_renderState)
   {
     auto rhi = m_renderState->rhi;
+
+    auto* slot = m_readbacks.acquire(ReadbackRing::clock::now());
+    if(!slot)
+    {
+      // Every readback is still in flight: wait for the GPU to complete them,
+      // and skip the frame if that was not enough
+      m_metrics->readbackOverruns.fetch_add(1, std::memory_order_relaxed);
+      rhi->finish();
+      if(!m_settings.lowLatency)
+      {
+        if(auto ready = m_readbacks.takeReady())
+          sendReadback(*ready);
+      }
+
+      slot = m_readbacks.acquire(ReadbackRing::clock::now());
+      if(!slot)
+        return;
+    }
+
+    if(m_inv_y_renderer)
+      m_inv_y_renderer->updateReadback(slot->result);
+    else if(m_downscale_renderer)
+      m_downscale_renderer->updateReadback(slot->result);
+
     QRhiCommandBuffer* cb{};
     if(rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess)
+    {
+      m_readbacks.cancel(*slot);
       return;
+    }
 
     renderer->render(*cb);
 
     rhi->endOffscreenFrame();
 
-    // Send the readback to Hyperion
-    if(m_connection)
+    // Send the most recent completed readback to Hyperion
+    if(!m_settings.lowLatency)
+    {
+      if(auto ready = m_readbacks.takeReady())
+        sendReadback(*ready);
+    }
+  }
+}
+
+void OutputNode::sendReadback(const ReadbackRing::Slot& slot)
+{
+  if(!m_connection)
+    return;
+
+  const auto& readback = slot.result;
+  auto width = readback.pixelSize.width();
+  auto height = readback.pixelSize.height();
+  const auto* data = reinterpret_cast<const uint8_t*>(readback.data.constData());
+
+  // The Null backend renders nothing: its readbacks are replaced by frames
+  // which change every time, so that the whole send path is exercised
+  if(m_settings.headless)
+  {
+    if(width <= 0 || height <= 0)
+    {
+      width = sendSize().width();
+      height = sendSize().height();
+    }
+    data = syntheticFrame(width, height);
+  }
+
+  if(width > 0 && height > 0 && data)
+  {
+    // With an LED layout only the per-LED colors leave the machine
+    if(m_leds.enabled())
+    {
+      m_leds.sample(data, width, height);
+      m_connection->sendImage(
+          m_leds.data(), m_leds.width(), m_leds.height(), -1, slot.rendered);
+    }
+    else
     {
-      auto& readback = *m_currentReadback;
-      auto width = readback.pixelSize.width();
-      auto height = readback.pixelSize.height();
+      m_connection->sendImage(data, width, height, -1, slot.rendered);
+    }
+  }
+}
 
-      if(width > 0 && height > 0 && !readback.data.isEmpty())
+const uint8_t* OutputNode::syntheticFrame(int width, int height)
+{
+  // A few moving gradients, generated once per size so that producing
+  // them does not weigh in the measured render thread time
+  const std::size_t bytes = std::size_t(width) * height * 4;
+  if(m_synthetic.empty() || m_synthetic.front().size() != bytes)
+  {
+    m_synthetic.assign(8, std::vector<uint8_t>(bytes));
+    for(std::size_t f = 0; f < m_synthetic.size(); f++)
+    {
+      uint8_t* p = m_synthetic[f].data();
+      for(int y = 0; y < height; y++)
       {
-        m_connection->sendImage(
-            reinterpret_cast<const uint8_t*>(readback.data.constData()),
-            width, height);
+        for(int x = 0; x < width; x++, p += 4)
+        {
+          p[0] = uint8_t(x * 255 / std::max(width - 1, 1) + f * 32);
+          p[1] = uint8_t(y * 255 / std::max(height - 1, 1));
+          p[2] = uint8_t(f * 32);
+          p[3] = 255;
+        }
       }
     }
-    
-    // Swap readback buffers
-    if(m_currentReadback == m_readback + 0)
-      m_currentReadback = m_readback + 1;
-    else
-      m_currentReadback = m_readback + 0;
-    
-    if(m_inv_y_renderer)
-      m_inv_y_renderer->updateReadback(*m_currentReadback);
   }
+
+  return m_synthetic[m_syntheticIndex++ % m_synthetic.size()].data();
 }
 
 score::gfx::OutputNode::Configuration OutputNode::configuration() const noexcept
@@ -181,20 +287,32 @@ void OutputNode::createOutput(
   m_renderState = std::make_shared<score::gfx::RenderState>();
   m_update = onUpdate;
 
-  m_renderState->surface = QRhiGles2InitParams::newFallbackSurface();
-  QRhiGles2InitParams params;
-  params.fallbackSurface = m_renderState->surface;
-  score::GLCapabilities caps;
-  caps.setupFormat(params.format);
-  m_renderState->rhi = QRhi::create(QRhi::OpenGLES2, &params, {});
+  if(m_settings.headless)
+  {
+    // No GPU nor display needed, e.g. to profile the pipeline on build servers
+    QRhiNullInitParams params;
+    m_renderState->rhi = QRhi::create(QRhi::Null, &params, {});
+    m_renderState->api = score::gfx::GraphicsApi::Null;
+  }
+  else
+  {
+    m_renderState->surface = QRhiGles2InitParams::newFallbackSurface();
+    QRhiGles2InitParams params;
+    params.fallbackSurface = m_renderState->surface;
+    score::GLCapabilities caps;
+    caps.setupFormat(params.format);
+    m_renderState->rhi = QRhi::create(QRhi::OpenGLES2, &params, {});
+    m_renderState->api = score::gfx::GraphicsApi::OpenGL;
+    m_renderState->version = caps.qShaderVersion;
+  }
   m_renderState->renderSize = QSize(m_settings.width, m_settings.height);
   m_renderState->outputSize = m_renderState->renderSize;
-  m_renderState->api = score::gfx::GraphicsApi::OpenGL;
-  m_renderState->version = caps.qShaderVersion;
 
+  // The output texture is the one read back: when a smaller send resolution
+  // is set, DownscaleRenderer reduces the full-size input into it.
   auto rhi = m_renderState->rhi;
   m_texture = rhi->newTexture(
-      QRhiTexture::RGBA8, m_renderState->renderSize, 1,
+      QRhiTexture::RGBA8, sendSize(), 1,
       QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
   m_texture->create();
   m_renderTarget = rhi->newTextureRenderTarget({m_texture});
@@ -218,8 +336,27 @@ OutputNode::createRenderer(score::gfx::RenderList& r) const noexcept
 {
   score::gfx::TextureRenderTarget rt{
       m_texture, nullptr, nullptr, m_renderState->renderPassDescriptor, m_renderTarget};
-  return const_cast<Gfx::InvertYRenderer*&>(m_inv_y_renderer) = new Gfx::InvertYRenderer{
-             *this, rt, const_cast<QRhiReadbackResult&>(m_readback[0])};
+  auto& readback = const_cast<ReadbackRing&>(m_readbacks).first().result;
+  const_cast<Gfx::InvertYRenderer*&>(m_inv_y_renderer) = nullptr;
+  const_cast<DownscaleRenderer*&>(m_downscale_renderer) = nullptr;
+
+  if(sendSize() != m_renderState->renderSize)
+    return const_cast<DownscaleRenderer*&>(m_downscale_renderer)
+           = new DownscaleRenderer{*this, rt, readback};
+  else
+    return const_cast<Gfx::InvertYRenderer*&>(m_inv_y_renderer)
+           = new Gfx::InvertYRenderer{*this, rt, readback};
+}
+
+QSize OutputNode::sendSize() const noexcept
+{
+  // Only downscaling makes sense, Hyperion samples a coarse LED grid anyway
+  const QSize full{m_settings.width, m_settings.height};
+  if(m_settings.sendWidth <= 0 || m_settings.sendHeight <= 0)
+    return full;
+  return QSize{
+      std::min(m_settings.sendWidth, full.width()),
+      std::min(m_settings.sendHeight, full.height())};
 }
 
 OutputDevice::OutputDevice(
@@ -1,16 +1,134 @@
 #pragma once
 #include <QString>
+#include <QStringList>
+
+#include <vector>
 
 namespace Hyperion
 {
+// One Hyperion instance receiving the output
+struct OutputTarget
+{
+  QString host;
+  int port{19400};
+  int priority{150};
+  // Path of a Unix domain socket, used instead of host and port when set
+  QString localSocket;
+
+  QString name() const
+  {
+    return localSocket.isEmpty() ? host + ':' + QString::number(port) : localSocket;
+  }
+};
+
 struct OutputSettings
 {
   QString host{"127.0.0.1"};
   int port{19400};
   int priority{150};
   QString origin{"ossiascore"};
+  // Same-host Hyperion: Unix domain socket path replacing host and port, empty for TCP
+  QString localSocket;
   int width{};
   int height{};
   double rate{};
+
+  // Frames sent per second to Hyperion, on a fixed schedule independent of the
+  // rendering: each send takes the newest rendered frame. 0 sends every frame.
+  double sendRate{};
+
+  // Rate at which each link schedules its sends
+  double effectiveSendRate() const noexcept
+  {
+    return sendRate > 0. && sendRate < rate ? sendRate : rate;
+  }
+
+  // Resolution actually read back and sent to Hyperion, 0 to use width x height
+  int sendWidth{};
+  int sendHeight{};
+
+  // Identical frames are not re-sent: Hyperion holds the last image, which
+  // is refreshed every keepAlive ms (0: held forever, never refreshed)
+  bool deduplicate{true};
+  int keepAlive{1000};
+
+  // A frame whose R, G and B each vary by at most this much is sent as a
+  // single Color command instead of an image, -1 to always send images.
+  // 0 only replaces frames of exactly one color, which changes nothing on the LEDs.
+  int colorTolerance{0};
+
+  // LED color correction, applied while converting the frames to RGB:
+  // brightness and white balance in percent, gamma exponent (1: linear).
+  // Hyperion's own corrections can then be left at their neutral values.
+  int brightness{100};
+  double gamma{1.};
+  int whiteRed{100};
+  int whiteGreen{100};
+  int whiteBlue{100};
+
+  bool colorCorrected() const noexcept
+  {
+    return brightness != 100 || gamma != 1. || whiteRed != 100 || whiteGreen != 100
+           || whiteBlue != 100;
+  }
+
+  // LED layout: when any count is set, only the average color of each LED's
+  // segment of the border, `ledDepth` percent deep, is sent, one pixel per LED
+  int ledTop{};
+  int ledRight{};
+  int ledBottom{};
+  int ledLeft{};
+  int ledDepth{10};
+
+  // Threads converting frames of half a megapixel or more, in row bands.
+  // 0 picks from the number of cores, 1 keeps the conversion on the render thread.
+  int conversionThreads{0};
+
+  // Maximum number of requests not yet acknowledged by Hyperion, 0 for no limit
+  int maxInFlight{2};
+
+  // Linux: frames above a few tens of KB are sent with MSG_ZEROCOPY, falling
+  // back to regular sends where the kernel cannot avoid the copy
+  bool zeroCopy{false};
+
+  // Number of frames which can be read back from the GPU at the same time.
+  // In low-latency mode a frame is sent from the readback completion itself.
+  int readbackDepth{2};
+  bool lowLatency{false};
+
+  // Renders on QRhi's Null backend and sends synthetic frames instead of
+  // the readbacks, to run and profile the whole pipeline without a GPU
+  bool headless{false};
+
+  // Every message sent to the main target is appended to this capture file,
+  // see StreamCapture, which score_addon_hyperion_replay plays back. Empty: none.
+  QString captureFile;
+
+  // More instances receiving the same frames, comma-separated "host[:port][/priority]".
+  // Port and priority default to the ones of the main target.
+  QString extraTargets;
+
+  std::vector<OutputTarget> targets() const
+  {
+    std::vector<OutputTarget> res{{host, port, priority, localSocket}};
+    for(const QString& entry : extraTargets.split(',', Qt::SkipEmptyParts))
+    {
+      OutputTarget t{
+          .host = entry.trimmed(), .port = port, .priority = priority, .localSocket = {}};
+      if(const auto slash = t.host.indexOf('/'); slash >= 0)
+      {
+        t.priority = t.host.mid(slash + 1).toInt();
+        t.host.truncate(slash);
+      }
+      if(const auto colon = t.host.indexOf(':'); colon >= 0)
+      {
+        t.port = t.host.mid(colon + 1).toInt();
+        t.host.truncate(colon);
+      }
+      if(!t.host.isEmpty() && t.port > 0)
+        res.push_back(std::move(t));
+    }
+    return res;
+  }
 };
 }
@@ -0,0 +1,63 @@
+#include "PacingTimer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#endif
+
+namespace Hyperion
+{
+PacingTimer::PacingTimer()
+{
+#if defined(__linux__)
+  m_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+}
+
+PacingTimer::~PacingTimer()
+{
+  if(m_fd >= 0)
+    ::close(m_fd);
+}
+
+void PacingTimer::arm(clock::time_point deadline) noexcept
+{
+#if defined(__linux__)
+  if(m_fd < 0)
+    return;
+
+  // steady_clock is CLOCK_MONOTONIC on Linux. A zero it_value would disarm the timer.
+  const auto ns = std::max<int64_t>(
+      1, std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch())
+             .count());
+  itimerspec spec{};
+  spec.it_value.tv_sec = ns / 1'000'000'000;
+  spec.it_value.tv_nsec = ns % 1'000'000'000;
+  ::timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#endif
+}
+
+void PacingTimer::disarm() noexcept
+{
+#if defined(__linux__)
+  if(m_fd < 0)
+    return;
+
+  itimerspec spec{};
+  ::timerfd_settime(m_fd, 0, &spec, nullptr);
+#endif
+}
+
+void PacingTimer::acknowledge() noexcept
+{
+  if(m_fd < 0)
+    return;
+
+  uint64_t expirations;
+  [[maybe_unused]] auto res = ::read(m_fd, &expirations, sizeof(expirations));
+}
+}
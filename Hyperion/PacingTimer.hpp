@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+
+namespace Hyperion
+{
+// Absolute CLOCK_MONOTONIC timer which can be polled along with sockets,
+// to wake up on a send deadline with microsecond precision instead of the
+// millisecond granularity of poll() timeouts. Backed by a timerfd on
+// Linux; elsewhere fd() is -1 and callers fall back to the poll timeout.
+class PacingTimer
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  PacingTimer();
+  ~PacingTimer();
+
+  PacingTimer(const PacingTimer&) = delete;
+  PacingTimer& operator=(const PacingTimer&) = delete;
+
+  int fd() const noexcept { return m_fd; }
+
+  // Fires once at `deadline`, replacing the previous one
+  void arm(clock::time_point deadline) noexcept;
+  void disarm() noexcept;
+
+  // Clears the expiration after fd() was reported readable
+  void acknowledge() noexcept;
+
+private:
+  int m_fd{-1};
+};
+}
@@ -0,0 +1,527 @@
+#include "PixelConversion.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HYPERION_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define HYPERION_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace Hyperion
+{
+
+void rgbaToRgbScalar(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept
+{
+  for(std::size_t i = 0; i < pixels; ++i)
+  {
+    dst[0] = src[0]; // R
+    dst[1] = src[1]; // G
+    dst[2] = src[2]; // B
+    dst += 3;
+    src += 4;
+  }
+}
+
+#if defined(HYPERION_X86_KERNELS)
+// 16 pixels per iteration: each 16-byte load is packed into 12 bytes,
+// then the four 12-byte chunks are stitched into three full 16-byte stores.
+__attribute__((target("ssse3"))) static void
+rgbaToRgbSSSE3(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept
+{
+  const __m128i mask
+      = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+  {
+    const auto* s = reinterpret_cast<const __m128i*>(src + i * 4);
+    auto* d = reinterpret_cast<__m128i*>(dst + i * 3);
+
+    const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(s + 0), mask);
+    const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), mask);
+    const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), mask);
+    const __m128i e = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), mask);
+
+    _mm_storeu_si128(d + 0, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storeu_si128(d + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+    _mm_storeu_si128(d + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(e, 4)));
+  }
+
+  rgbaToRgbScalar(src + i * 4, dst + i * 3, pixels - i);
+}
+
+// Packs 8 RGBA pixels in-lane to 2x12 bytes, then joins the lanes into the low 24 bytes
+__attribute__((target("avx2"))) static inline __m256i pack8AVX2(const uint8_t* s) noexcept
+{
+  const __m256i mask = _mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, //
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+  return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), join);
+}
+
+// Each 32-byte store spills 8 bytes past the 24 valid ones, which get
+// overwritten by the next step, so the loops stop early enough to never
+// write outside of [dst, dst + pixels * 3).
+__attribute__((target("avx2"))) static void
+rgbaToRgbAVX2(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept
+{
+  std::size_t i = 0;
+  for(; i + 35 <= pixels; i += 32)
+  {
+    const __m256i a = pack8AVX2(src + i * 4);
+    const __m256i b = pack8AVX2(src + i * 4 + 32);
+    const __m256i c = pack8AVX2(src + i * 4 + 64);
+    const __m256i d = pack8AVX2(src + i * 4 + 96);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 3), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 3 + 24), b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 3 + 48), c);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 3 + 72), d);
+  }
+
+  for(; i + 11 <= pixels; i += 8)
+  {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 3), pack8AVX2(src + i * 4));
+  }
+
+  rgbaToRgbScalar(src + i * 4, dst + i * 3, pixels - i);
+}
+#endif
+
+#if defined(HYPERION_NEON_KERNELS)
+static void rgbaToRgbNEON(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept
+{
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+  {
+    const uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+    uint8x16x3_t rgb;
+    rgb.val[0] = rgba.val[0];
+    rgb.val[1] = rgba.val[1];
+    rgb.val[2] = rgba.val[2];
+    vst3q_u8(dst + i * 3, rgb);
+  }
+
+  rgbaToRgbScalar(src + i * 4, dst + i * 3, pixels - i);
+}
+#endif
+
+namespace
+{
+struct KernelList
+{
+  std::array<RgbaToRgbKernel, 4> kernels{};
+  std::size_t count{};
+
+  void add(const char* name, RgbaToRgbFunction f) { kernels[count++] = {name, f}; }
+};
+
+const KernelList& kernelList() noexcept
+{
+  static const KernelList list = [] {
+    KernelList l;
+    l.add("scalar", rgbaToRgbScalar);
+#if defined(HYPERION_X86_KERNELS)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("ssse3"))
+      l.add("ssse3", rgbaToRgbSSSE3);
+    if(__builtin_cpu_supports("avx2"))
+      l.add("avx2", rgbaToRgbAVX2);
+#endif
+#if defined(HYPERION_NEON_KERNELS)
+    l.add("neon", rgbaToRgbNEON);
+#endif
+    return l;
+  }();
+  return list;
+}
+}
+
+std::span<const RgbaToRgbKernel> availableRgbaToRgbKernels() noexcept
+{
+  const auto& l = kernelList();
+  return {l.kernels.data(), l.count};
+}
+
+const RgbaToRgbKernel& selectedRgbaToRgbKernel() noexcept
+{
+  // The list is ordered from the slowest to the fastest kernel
+  static const RgbaToRgbKernel& k = availableRgbaToRgbKernels().back();
+  return k;
+}
+
+void rgbaToRgb(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept
+{
+  static const RgbaToRgbFunction f = selectedRgbaToRgbKernel().convert;
+  f(src, dst, pixels);
+}
+
+ColorLut ColorLut::make(
+    double brightness, double gamma, double red, double green, double blue) noexcept
+{
+  ColorLut lut;
+  const double gains[3]{red, green, blue};
+  std::array<uint8_t, 256>* tables[3]{&lut.r, &lut.g, &lut.b};
+  gamma = gamma > 0. ? gamma : 1.;
+  for(int c = 0; c < 3; c++)
+  {
+    const double scale = 255. * std::max(0., brightness * gains[c]);
+    for(int v = 0; v < 256; v++)
+    {
+      const double out = std::round(scale * std::pow(v / 255., gamma));
+      (*tables[c])[v] = uint8_t(std::clamp(out, 0., 255.));
+    }
+  }
+  return lut;
+}
+
+bool ColorLut::isIdentity() const noexcept
+{
+  for(int v = 0; v < 256; v++)
+    if(r[v] != v || g[v] != v || b[v] != v)
+      return false;
+  return true;
+}
+
+uint32_t ColorLut::apply(uint32_t rgb) const noexcept
+{
+  return uint32_t(r[(rgb >> 16) & 0xFF]) << 16 | uint32_t(g[(rgb >> 8) & 0xFF]) << 8
+         | uint32_t(b[rgb & 0xFF]);
+}
+
+void rgbaToRgbLutScalar(
+    const uint8_t* src, uint8_t* dst, std::size_t pixels, const ColorLut& lut) noexcept
+{
+  for(std::size_t i = 0; i < pixels; ++i)
+  {
+    dst[0] = lut.r[src[0]];
+    dst[1] = lut.g[src[1]];
+    dst[2] = lut.b[src[2]];
+    dst += 3;
+    src += 4;
+  }
+}
+
+#if defined(__aarch64__)
+// 256-entry table lookup as four 64-byte ones: out-of-range indices
+// leave the lanes set by the previous quarters untouched
+static inline uint8x16_t lookup256(const uint8x16x4_t (&t)[4], uint8x16_t idx) noexcept
+{
+  const uint8x16_t quarter = vdupq_n_u8(64);
+  uint8x16_t res = vqtbl4q_u8(t[0], idx);
+  idx = vsubq_u8(idx, quarter);
+  res = vqtbx4q_u8(res, t[1], idx);
+  idx = vsubq_u8(idx, quarter);
+  res = vqtbx4q_u8(res, t[2], idx);
+  idx = vsubq_u8(idx, quarter);
+  return vqtbx4q_u8(res, t[3], idx);
+}
+
+static void rgbaToRgbLutNEON(
+    const uint8_t* src, uint8_t* dst, std::size_t pixels, const ColorLut& lut) noexcept
+{
+  uint8x16x4_t tables[3][4];
+  const std::array<uint8_t, 256>* channels[3]{&lut.r, &lut.g, &lut.b};
+  for(int c = 0; c < 3; c++)
+    for(int q = 0; q < 4; q++)
+      tables[c][q] = vld1q_u8_x4(channels[c]->data() + q * 64);
+
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+  {
+    const uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+    uint8x16x3_t rgb;
+    rgb.val[0] = lookup256(tables[0], rgba.val[0]);
+    rgb.val[1] = lookup256(tables[1], rgba.val[1]);
+    rgb.val[2] = lookup256(tables[2], rgba.val[2]);
+    vst3q_u8(dst + i * 3, rgb);
+  }
+
+  rgbaToRgbLutScalar(src + i * 4, dst + i * 3, pixels - i, lut);
+}
+#endif
+
+// x86 has no byte gather before AVX-512 VBMI: the tables, which stay in L1,
+// are read with scalar loads, still in the single pass over the frame
+void rgbaToRgbLut(
+    const uint8_t* src, uint8_t* dst, std::size_t pixels, const ColorLut& lut) noexcept
+{
+#if defined(__aarch64__)
+  rgbaToRgbLutNEON(src, dst, pixels, lut);
+#else
+  rgbaToRgbLutScalar(src, dst, pixels, lut);
+#endif
+}
+
+// Per-channel minimum and maximum of the RGBA pixels, accumulated into lo and hi
+using MinMaxFunction
+    = void (*)(const uint8_t* src, std::size_t pixels, uint8_t* lo, uint8_t* hi);
+
+static void minMaxScalar(const uint8_t* src, std::size_t pixels, uint8_t* lo, uint8_t* hi) noexcept
+{
+  for(std::size_t i = 0; i < pixels; ++i, src += 4)
+  {
+    for(int c = 0; c < 4; c++)
+    {
+      lo[c] = std::min(lo[c], src[c]);
+      hi[c] = std::max(hi[c], src[c]);
+    }
+  }
+}
+
+#if defined(HYPERION_X86_KERNELS)
+// Folds the four pixels of each register into the first one
+__attribute__((target("sse2"))) static void
+foldMinMaxSSE2(__m128i mn, __m128i mx, uint8_t* lo, uint8_t* hi) noexcept
+{
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+  mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+  mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+  const uint32_t l = _mm_cvtsi128_si32(mn);
+  const uint32_t h = _mm_cvtsi128_si32(mx);
+  std::memcpy(lo, &l, 4);
+  std::memcpy(hi, &h, 4);
+}
+
+__attribute__((target("sse2"))) static void
+minMaxSSE2(const uint8_t* src, std::size_t pixels, uint8_t* lo, uint8_t* hi) noexcept
+{
+  uint32_t l, h;
+  std::memcpy(&l, lo, 4);
+  std::memcpy(&h, hi, 4);
+  __m128i mn = _mm_set1_epi32(l);
+  __m128i mx = _mm_set1_epi32(h);
+
+  std::size_t i = 0;
+  for(; i + 4 <= pixels; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    mn = _mm_min_epu8(mn, v);
+    mx = _mm_max_epu8(mx, v);
+  }
+  foldMinMaxSSE2(mn, mx, lo, hi);
+
+  minMaxScalar(src + i * 4, pixels - i, lo, hi);
+}
+
+__attribute__((target("avx2"))) static void
+minMaxAVX2(const uint8_t* src, std::size_t pixels, uint8_t* lo, uint8_t* hi) noexcept
+{
+  uint32_t l, h;
+  std::memcpy(&l, lo, 4);
+  std::memcpy(&h, hi, 4);
+  __m256i mn = _mm256_set1_epi32(l);
+  __m256i mx = _mm256_set1_epi32(h);
+
+  std::size_t i = 0;
+  for(; i + 8 <= pixels; i += 8)
+  {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+    mn = _mm256_min_epu8(mn, v);
+    mx = _mm256_max_epu8(mx, v);
+  }
+  foldMinMaxSSE2(
+      _mm_min_epu8(_mm256_castsi256_si128(mn), _mm256_extracti128_si256(mn, 1)),
+      _mm_max_epu8(_mm256_castsi256_si128(mx), _mm256_extracti128_si256(mx, 1)), lo, hi);
+
+  minMaxScalar(src + i * 4, pixels - i, lo, hi);
+}
+#endif
+
+#if defined(HYPERION_NEON_KERNELS)
+static void minMaxNEON(const uint8_t* src, std::size_t pixels, uint8_t* lo, uint8_t* hi) noexcept
+{
+  uint32_t l, h;
+  std::memcpy(&l, lo, 4);
+  std::memcpy(&h, hi, 4);
+  uint8x16_t mn = vreinterpretq_u8_u32(vdupq_n_u32(l));
+  uint8x16_t mx = vreinterpretq_u8_u32(vdupq_n_u32(h));
+
+  std::size_t i = 0;
+  for(; i + 4 <= pixels; i += 4)
+  {
+    const uint8x16_t v = vld1q_u8(src + i * 4);
+    mn = vminq_u8(mn, v);
+    mx = vmaxq_u8(mx, v);
+  }
+
+  uint8_t mns[16], mxs[16];
+  vst1q_u8(mns, mn);
+  vst1q_u8(mxs, mx);
+  minMaxScalar(mns, 4, lo, hi);
+  minMaxScalar(mxs, 4, lo, hi);
+
+  minMaxScalar(src + i * 4, pixels - i, lo, hi);
+}
+#endif
+
+std::optional<uint32_t>
+uniformColor(const uint8_t* rgba, std::size_t pixels, int tolerance) noexcept
+{
+  static const MinMaxFunction minMax = [] {
+#if defined(HYPERION_X86_KERNELS)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+      return minMaxAVX2;
+    if(__builtin_cpu_supports("sse2"))
+      return minMaxSSE2;
+#endif
+#if defined(HYPERION_NEON_KERNELS)
+    return minMaxNEON;
+#endif
+    return minMaxScalar;
+  }();
+
+  if(pixels == 0 || tolerance < 0)
+    return std::nullopt;
+
+  // Blocks small enough to give up early on varying content,
+  // large enough to keep the range check out of the inner loop
+  constexpr std::size_t block = 4096;
+  uint8_t lo[4]{255, 255, 255, 255};
+  uint8_t hi[4]{0, 0, 0, 0};
+  for(std::size_t i = 0; i < pixels; i += block)
+  {
+    minMax(rgba + i * 4, std::min(block, pixels - i), lo, hi);
+    for(int c = 0; c < 3; c++)
+      if(hi[c] - lo[c] > tolerance)
+        return std::nullopt;
+  }
+
+  uint32_t color = 0;
+  for(int c = 0; c < 3; c++)
+    color = (color << 8) | uint32_t((lo[c] + hi[c] + 1) / 2);
+  return color;
+}
+
+using SumFunction = void (*)(const uint8_t* src, std::size_t pixels, uint64_t* sums);
+
+static void sumRgbaScalar(const uint8_t* src, std::size_t pixels, uint64_t* sums) noexcept
+{
+  uint32_t acc[4]{};
+  for(std::size_t i = 0; i < pixels; ++i, src += 4)
+    for(int c = 0; c < 4; c++)
+      acc[c] += src[c];
+  for(int c = 0; c < 4; c++)
+    sums[c] += acc[c];
+}
+
+#if defined(HYPERION_X86_KERNELS)
+// Widens 4 pixels to 16 bits, folds them into 2, then accumulates one 32-bit lane per channel
+__attribute__((target("sse2"))) static void
+sumRgbaSSE2(const uint8_t* src, std::size_t pixels, uint64_t* sums) noexcept
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for(; i + 4 <= pixels; i += 4)
+  {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+    const __m128i s = _mm_add_epi16(_mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero));
+    acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(s, zero));
+    acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(s, zero));
+  }
+
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  for(int c = 0; c < 4; c++)
+    sums[c] += lanes[c];
+
+  sumRgbaScalar(src + i * 4, pixels - i, sums);
+}
+#endif
+
+#if defined(HYPERION_NEON_KERNELS)
+static void sumRgbaNEON(const uint8_t* src, std::size_t pixels, uint64_t* sums) noexcept
+{
+  uint32x4_t acc[4]{vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0)};
+
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+  {
+    const uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+    for(int c = 0; c < 4; c++)
+      acc[c] = vpadalq_u16(acc[c], vpaddlq_u8(rgba.val[c]));
+  }
+
+  for(int c = 0; c < 4; c++)
+  {
+    uint32_t lanes[4];
+    vst1q_u32(lanes, acc[c]);
+    sums[c] += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  sumRgbaScalar(src + i * 4, pixels - i, sums);
+}
+#endif
+
+void sumRgba(const uint8_t* rgba, std::size_t pixels, uint64_t* sums) noexcept
+{
+  static const SumFunction sum = [] {
+#if defined(HYPERION_X86_KERNELS)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2"))
+      return sumRgbaSSE2;
+#endif
+#if defined(HYPERION_NEON_KERNELS)
+    return sumRgbaNEON;
+#endif
+    return sumRgbaScalar;
+  }();
+
+  // The kernels accumulate in 32-bit lanes, which cannot overflow within a chunk
+  constexpr std::size_t chunk = std::size_t(1) << 20;
+  for(std::size_t i = 0; i < pixels; i += chunk)
+    sum(rgba + i * 4, std::min(chunk, pixels - i), sums);
+}
+
+static inline uint64_t rotl64(uint64_t v, int r) noexcept
+{
+  return (v << r) | (v >> (64 - r));
+}
+
+// Four independent multiply-rotate lanes over 32-byte blocks (xxHash64-like),
+// which keeps the multipliers busy and runs close to memory bandwidth.
+uint64_t hashPixels(const uint8_t* data, std::size_t bytes) noexcept
+{
+  constexpr uint64_t k1 = 0x9E3779B185EBCA87ULL;
+  constexpr uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+  constexpr uint64_t k3 = 0x165667B19E3779F9ULL;
+
+  uint64_t h[4] = {k1 + k2, k2, 0, 0 - k1};
+  std::size_t i = 0;
+  for(; i + 32 <= bytes; i += 32)
+  {
+    for(int l = 0; l < 4; l++)
+    {
+      uint64_t v;
+      std::memcpy(&v, data + i + 8 * l, 8);
+      h[l] = rotl64(h[l] + v * k2, 31) * k1;
+    }
+  }
+
+  uint64_t r = rotl64(h[0], 1) + rotl64(h[1], 7) + rotl64(h[2], 12) + rotl64(h[3], 18);
+  r ^= bytes;
+  for(; i < bytes; i++)
+    r = rotl64(r ^ (data[i] * k3), 11) * k1;
+
+  r ^= r >> 33;
+  r *= k2;
+  r ^= r >> 29;
+  r *= k3;
+  r ^= r >> 32;
+  return r;
+}
+}
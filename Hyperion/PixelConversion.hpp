@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace Hyperion
+{
+using RgbaToRgbFunction = void (*)(const uint8_t* src, uint8_t* dst, std::size_t pixels);
+
+struct RgbaToRgbKernel
+{
+  const char* name{};
+  RgbaToRgbFunction convert{};
+};
+
+// Strips the alpha channel of `pixels` RGBA pixels from src into dst (3 bytes per pixel).
+// Uses the fastest kernel supported by the CPU, selected on first use.
+void rgbaToRgb(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept;
+
+// Reference implementation, all the vectorized kernels must match it bit-exactly
+void rgbaToRgbScalar(const uint8_t* src, uint8_t* dst, std::size_t pixels) noexcept;
+
+// Kernel used by rgbaToRgb()
+const RgbaToRgbKernel& selectedRgbaToRgbKernel() noexcept;
+
+// All the kernels usable on this CPU, scalar first
+std::span<const RgbaToRgbKernel> availableRgbaToRgbKernels() noexcept;
+
+// Per-channel 8-bit lookup tables: LED brightness, gamma and white balance
+// applied by the RGB conversion itself, in the same pass over the pixels
+struct ColorLut
+{
+  std::array<uint8_t, 256> r{};
+  std::array<uint8_t, 256> g{};
+  std::array<uint8_t, 256> b{};
+
+  // out = 255 * brightness * channel gain * (in / 255) ^ gamma, rounded and clamped.
+  // Brightness and gains are factors, 1 leaves the values unchanged.
+  static ColorLut
+  make(double brightness, double gamma, double red, double green, double blue) noexcept;
+
+  bool isIdentity() const noexcept;
+
+  // A Color command goes through the same correction, 0x00RRGGBB
+  uint32_t apply(uint32_t rgb) const noexcept;
+};
+
+// rgbaToRgb() mapping each channel through its table
+void rgbaToRgbLut(
+    const uint8_t* src, uint8_t* dst, std::size_t pixels, const ColorLut& lut) noexcept;
+
+// Reference implementation of rgbaToRgbLut()
+void rgbaToRgbLutScalar(
+    const uint8_t* src, uint8_t* dst, std::size_t pixels, const ColorLut& lut) noexcept;
+
+// If R, G and B each vary by at most `tolerance` over the whole RGBA image,
+// returns the middle of their ranges as 0x00RRGGBB, the layout of the Color command.
+// Alpha is ignored. Stops as soon as a block of pixels exceeds the tolerance.
+std::optional<uint32_t>
+uniformColor(const uint8_t* rgba, std::size_t pixels, int tolerance) noexcept;
+
+// Adds the R, G, B and A values of `pixels` RGBA pixels to sums[0..3]
+void sumRgba(const uint8_t* rgba, std::size_t pixels, uint64_t* sums) noexcept;
+
+// Fast non-cryptographic 64-bit hash, used to detect repeated frames
+uint64_t hashPixels(const uint8_t* data, std::size_t bytes) noexcept;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace Hyperion
+{
+// AIMD control of the image send rate. The rate is cut multiplicatively
+// as soon as the link shows a backlog, and probed back up additively
+// towards the configured rate while it keeps up, so that latency stays
+// bounded instead of frames queuing in the socket buffers.
+class RateController
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit RateController(double maxRate = 60.)
+  {
+    reset(maxRate);
+  }
+
+  void reset(double maxRate)
+  {
+    m_maxRate = maxRate > 0. ? maxRate : 60.;
+    m_rate = m_maxRate;
+    m_lastChange = {};
+  }
+
+  double rate() const noexcept { return m_rate; }
+  double maxRate() const noexcept { return m_maxRate; }
+
+  // True when running below the configured rate, i.e. sends have to be paced
+  bool limited() const noexcept { return m_rate < m_maxRate; }
+
+  clock::duration interval() const noexcept
+  {
+    return std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>{1. / m_rate});
+  }
+
+  // Called after each image send with what the kernel still holds for the
+  // socket and how long the send took, including waits on a full buffer
+  void sent(
+      clock::time_point now, std::size_t frameBytes, std::size_t backlog,
+      clock::duration sendDuration) noexcept
+  {
+    if(backlog > frameBytes || sendDuration > interval() / 2)
+      congested(now);
+    else
+      uncongested(now);
+  }
+
+  // Called when sending is held back because Hyperion does not keep up
+  void congested(clock::time_point now) noexcept
+  {
+    if(now - m_lastChange < decreaseHoldoff)
+      return;
+    m_rate = std::max(minRate, m_rate * 0.75);
+    m_lastChange = now;
+  }
+
+  void uncongested(clock::time_point now) noexcept
+  {
+    if(m_rate >= m_maxRate || now - m_lastChange < increaseInterval)
+      return;
+    m_rate = std::min(m_maxRate, m_rate + m_maxRate * 0.05);
+    m_lastChange = now;
+  }
+
+private:
+  static constexpr double minRate = 1.;
+  static constexpr auto decreaseHoldoff = std::chrono::milliseconds{200};
+  static constexpr auto increaseInterval = std::chrono::milliseconds{250};
+
+  double m_maxRate{};
+  double m_rate{};
+  clock::time_point m_lastChange{};
+};
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <Gfx/Graph/RenderList.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Hyperion
+{
+// Ring of readback results. Each frame reads back into its own slot, which
+// stays reserved until QRhi reports the readback as completed, so that up
+// to depth() readbacks can be in flight on backends that complete them late.
+class ReadbackRing
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Slot
+  {
+    QRhiReadbackResult result;
+    clock::time_point rendered;
+    uint64_t sequence{};
+    bool pending{}; // Readback requested and not completed yet
+    bool ready{};   // Completed and not consumed yet
+  };
+
+  // With onCompleted, slots are consumed from QRhi's completion callback as
+  // soon as their readback is done; otherwise they wait for takeReady().
+  void reset(int depth, std::function<void(Slot&)> onCompleted = {})
+  {
+    m_onCompleted = std::move(onCompleted);
+    m_slots = std::vector<Slot>(std::clamp(depth, 1, maxDepth));
+    for(auto& slot : m_slots)
+      slot.result.completed = [this, &slot] { complete(slot); };
+    m_next = 0;
+    m_sequence = 0;
+  }
+
+  int depth() const noexcept { return int(m_slots.size()); }
+
+  Slot& first() noexcept { return m_slots.front(); }
+
+  // Reserves the slot the frame about to be rendered is read back into,
+  // null when every slot is still in flight: their readbacks must complete
+  // first, a slot is never reused before its result was consumed.
+  Slot* acquire(clock::time_point rendered)
+  {
+    Slot* slot = nullptr;
+    for(std::size_t i = 0; i < m_slots.size() && !slot; i++)
+    {
+      auto& candidate = m_slots[(m_next + i) % m_slots.size()];
+      if(!candidate.pending)
+        slot = &candidate;
+    }
+
+    if(!slot)
+      return nullptr;
+
+    // QRhi reads back into the slot's array without reallocating when it
+    // is large enough. It only shrinks here, after a resolution drop.
+    auto& data = slot->result.data;
+    if(data.capacity() > 2 * data.size())
+      data.squeeze();
+
+    m_next = (std::size_t(slot - m_slots.data()) + 1) % m_slots.size();
+    slot->rendered = rendered;
+    slot->sequence = ++m_sequence;
+    slot->pending = true;
+    slot->ready = false;
+    return slot;
+  }
+
+  // The frame could not be rendered, the slot will not complete
+  void cancel(Slot& slot) noexcept { slot.pending = false; }
+
+  // Newest completed slot, older ones are superseded by it
+  Slot* takeReady() noexcept
+  {
+    Slot* newest = nullptr;
+    for(auto& slot : m_slots)
+    {
+      if(slot.ready && (!newest || slot.sequence > newest->sequence))
+        newest = &slot;
+      slot.ready = false;
+    }
+    return newest;
+  }
+
+private:
+  static constexpr int maxDepth = 8;
+
+  void complete(Slot& slot)
+  {
+    slot.pending = false;
+    if(m_onCompleted)
+      m_onCompleted(slot);
+    else
+      slot.ready = true;
+  }
+
+  std::vector<Slot> m_slots;
+  std::function<void(Slot&)> m_onCompleted;
+  std::size_t m_next{};
+  uint64_t m_sequence{};
+};
+}
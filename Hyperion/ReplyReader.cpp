@@ -0,0 +1,82 @@
+#include "ReplyReader.hpp"
+
+#include "hyperion_reply_generated.h"
+
+#include <sys/socket.h>
+#include <errno.h>
+
+namespace Hyperion
+{
+// Replies are tiny, anything bigger means the stream is out of sync
+static constexpr uint32_t maxReplySize = 64 * 1024;
+
+ReplyReader::Status ReplyReader::receive(int fd)
+{
+  // Drop what was already parsed before appending
+  if(m_read > 0)
+  {
+    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_read);
+    m_read = 0;
+  }
+
+  uint8_t chunk[4096];
+  for(;;)
+  {
+    const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+    if(n > 0)
+    {
+      m_buffer.insert(m_buffer.end(), chunk, chunk + n);
+      continue;
+    }
+
+    if(n == 0)
+      return Status::Closed;
+    if(errno == EINTR)
+      continue;
+    if(errno == EAGAIN || errno == EWOULDBLOCK)
+      return Status::Ok;
+    return Status::Error;
+  }
+}
+
+std::optional<Reply> ReplyReader::next()
+{
+  const std::size_t available = m_buffer.size() - m_read;
+  if(available < 4)
+    return std::nullopt;
+
+  const uint8_t* header = m_buffer.data() + m_read;
+  const uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+                        | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+  if(size > maxReplySize)
+  {
+    m_desynchronized = true;
+    return std::nullopt;
+  }
+
+  if(available < 4 + size)
+    return std::nullopt;
+
+  const uint8_t* body = header + 4;
+  m_read += 4 + size;
+
+  flatbuffers::Verifier verifier{body, size};
+  if(!hyperionnet::VerifyReplyBuffer(verifier))
+    return Reply{.error = "Invalid reply"};
+
+  auto reply = hyperionnet::GetReply(body);
+  Reply r;
+  r.video = reply->video();
+  r.registered = reply->registered();
+  if(auto err = reply->error())
+    r.error.assign(err->c_str(), err->size());
+  return r;
+}
+
+void ReplyReader::reset()
+{
+  m_buffer.clear();
+  m_read = 0;
+  m_desynchronized = false;
+}
+}
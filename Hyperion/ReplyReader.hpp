@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Hyperion
+{
+struct Reply
+{
+  std::string error;
+  int video{-1};
+  int registered{-1};
+};
+
+// Accumulates the length-prefixed Reply messages Hyperion sends back
+// for every Request, from a non-blocking socket.
+class ReplyReader
+{
+public:
+  enum class Status
+  {
+    Ok,
+    Closed,
+    Error
+  };
+
+  // Reads everything currently available on the socket
+  Status receive(int fd);
+
+  // Pops the next complete message, if any. Messages which fail
+  // verification are returned with an error.
+  std::optional<Reply> next();
+
+  // The stream cannot be parsed anymore, the connection has to be reset
+  bool desynchronized() const noexcept { return m_desynchronized; }
+
+  void reset();
+
+private:
+  std::vector<uint8_t> m_buffer;
+  std::size_t m_read{};
+  bool m_desynchronized{};
+};
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Hyperion
+{
+// FIFO on a circular buffer which only allocates when it grows. Unlike a
+// std::deque, which allocates and frees blocks as items go through it,
+// pushing and popping at a steady rate does not touch the heap.
+template <typename T>
+class RingQueue
+{
+public:
+  bool empty() const noexcept { return m_size == 0; }
+  std::size_t size() const noexcept { return m_size; }
+
+  T& front() noexcept { return m_items[m_head]; }
+  const T& front() const noexcept { return m_items[m_head]; }
+
+  // From the oldest item
+  T& operator[](std::size_t i) noexcept { return m_items[(m_head + i) % m_items.size()]; }
+
+  void push_back(T item)
+  {
+    if(m_size == m_items.size())
+      grow();
+    m_items[(m_head + m_size) % m_items.size()] = std::move(item);
+    m_size++;
+  }
+
+  // The slot is reset, releasing what the item held
+  void pop_front()
+  {
+    m_items[m_head] = T{};
+    m_head = (m_head + 1) % m_items.size();
+    m_size--;
+  }
+
+  void reserve(std::size_t capacity)
+  {
+    while(m_items.size() < capacity)
+      grow();
+  }
+
+  void clear()
+  {
+    while(!empty())
+      pop_front();
+    m_head = 0;
+  }
+
+private:
+  void grow()
+  {
+    std::vector<T> items(std::max<std::size_t>(16, m_items.size() * 2));
+    for(std::size_t i = 0; i < m_size; i++)
+      items[i] = std::move((*this)[i]);
+    m_items = std::move(items);
+    m_head = 0;
+  }
+
+  std::vector<T> m_items;
+  std::size_t m_head{};
+  std::size_t m_size{};
+};
+}
@@ -0,0 +1,90 @@
+#include "RowBandPool.hpp"
+
+#include <algorithm>
+
+namespace Hyperion
+{
+RowBandPool::RowBandPool(int threads)
+    : m_threads{threads > 0 ? threads
+                            : std::clamp(int(std::thread::hardware_concurrency() / 2), 1, 4)}
+{
+}
+
+RowBandPool::~RowBandPool()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    m_stopped = true;
+  }
+  m_wake.notify_all();
+
+  for(auto& t : m_workers)
+    t.join();
+}
+
+void RowBandPool::start()
+{
+  for(int i = 1; i < m_threads; i++)
+    m_workers.emplace_back([this, i] { work(i); });
+}
+
+void RowBandPool::run(int width, int rows, BandFunction f, void* context)
+{
+  if(m_threads <= 1 || rows < m_threads
+     || std::size_t(width) * std::size_t(rows) < minParallelPixels)
+  {
+    f(context, 0, rows);
+    return;
+  }
+
+  if(m_workers.empty())
+    start();
+
+  {
+    std::lock_guard lock{m_mutex};
+    m_function = f;
+    m_context = context;
+    m_rows = rows;
+    m_bands = m_threads;
+    m_remaining = int(m_workers.size());
+    m_job++;
+  }
+  m_wake.notify_all();
+
+  f(context, 0, rows / m_threads);
+
+  std::unique_lock lock{m_mutex};
+  m_done.wait(lock, [this] { return m_remaining == 0; });
+}
+
+void RowBandPool::work(int index)
+{
+  uint64_t seen = 0;
+  for(;;)
+  {
+    BandFunction f{};
+    void* context{};
+    int rows{}, bands{};
+    {
+      std::unique_lock lock{m_mutex};
+      m_wake.wait(lock, [&] { return m_stopped || m_job != seen; });
+      if(m_stopped)
+        return;
+
+      seen = m_job;
+      f = m_function;
+      context = m_context;
+      rows = m_rows;
+      bands = m_bands;
+    }
+
+    if(index < bands)
+      f(context, index * rows / bands, (index + 1) * rows / bands);
+
+    // The caller's wait acquires the mutex, which publishes the band's writes
+    std::lock_guard lock{m_mutex};
+    if(--m_remaining == 0)
+      m_done.notify_one();
+  }
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Hyperion
+{
+// Small persistent pool splitting the per-pixel passes of large frames into
+// bands of rows. The calling thread processes the first band and waits for
+// the others. Workers are only started by the first frame large enough to
+// be split, smaller ones always run on the calling thread.
+class RowBandPool
+{
+public:
+  // Below this many pixels, waking the workers costs more than it saves
+  static constexpr std::size_t minParallelPixels = 512 * 1024;
+
+  // `threads` includes the calling one, 0 picks from the core count
+  explicit RowBandPool(int threads = 0);
+  ~RowBandPool();
+
+  RowBandPool(const RowBandPool&) = delete;
+  RowBandPool& operator=(const RowBandPool&) = delete;
+
+  int threads() const noexcept { return m_threads; }
+
+  // Calls f(firstRow, endRow) over [0, rows), in parallel when the frame is large enough.
+  // Only one frame at a time: called from a single thread.
+  template <typename F>
+  void forEachBand(int width, int rows, F&& f)
+  {
+    run(width, rows, [](void* ctx, int begin, int end) { (*static_cast<F*>(ctx))(begin, end); },
+        &f);
+  }
+
+private:
+  using BandFunction = void (*)(void* context, int begin, int end);
+
+  void run(int width, int rows, BandFunction f, void* context);
+  void start();
+  void work(int index);
+
+  int m_threads{};
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  uint64_t m_job{};
+  int m_remaining{};
+  bool m_stopped{};
+
+  // Current job, published under m_mutex
+  BandFunction m_function{};
+  void* m_context{};
+  int m_rows{};
+  int m_bands{};
+};
+}
@@ -0,0 +1,385 @@
+#include "StreamCapture.hpp"
+#include "FrameEncoder.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Hyperion
+{
+namespace
+{
+// The mapping grows by this much at a time, to amortize the remaps
+constexpr std::size_t growStep = 16 * 1024 * 1024;
+
+constexpr std::size_t align8(std::size_t n) noexcept
+{
+  return (n + 7) & ~std::size_t(7);
+}
+
+std::size_t pageSize() noexcept
+{
+  static const std::size_t size = std::size_t(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+template <typename T>
+T load(const uint8_t* p) noexcept
+{
+  T v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+template <typename T>
+void store(uint8_t* p, T v) noexcept
+{
+  std::memcpy(p, &v, sizeof(v));
+}
+}
+
+// CaptureWriter
+
+CaptureWriter::~CaptureWriter()
+{
+  close();
+}
+
+bool CaptureWriter::open(const std::string& path)
+{
+  close();
+  m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(m_fd < 0)
+    return false;
+
+  m_size = 0;
+  if(!reserve(Capture::headerSize))
+  {
+    const int err = errno;
+    close();
+    errno = err;
+    return false;
+  }
+
+  const int64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+  uint8_t* p = m_map;
+  std::memcpy(p, Capture::magic, sizeof(Capture::magic));
+  store<uint32_t>(p + 8, Capture::version);
+  store<uint32_t>(p + 12, uint32_t(Capture::headerSize));
+  store<int64_t>(p + 16, start);
+  m_size = Capture::headerSize;
+  return true;
+}
+
+void CaptureWriter::close()
+{
+  if(m_map)
+  {
+    ::munmap(m_map, m_mapSize);
+    m_map = nullptr;
+  }
+  if(m_fd >= 0)
+  {
+    [[maybe_unused]] int res = ::ftruncate(m_fd, off_t(m_size));
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_mapOffset = 0;
+  m_mapSize = 0;
+}
+
+bool CaptureWriter::reserve(std::size_t bytes)
+{
+  if(m_size + bytes <= m_mapOffset + m_mapSize)
+    return true;
+
+  if(m_map)
+  {
+    ::munmap(m_map, m_mapSize);
+    m_map = nullptr;
+  }
+
+  // Map again from the page holding the write position
+  const std::size_t page = pageSize();
+  const std::size_t offset = m_size / page * page;
+  const std::size_t length
+      = (std::max(growStep, m_size - offset + bytes) + page - 1) / page * page;
+
+  // Allocating the blocks up front turns a full disk into an error here,
+  // instead of a SIGBUS when writing to the mapping
+#if defined(__linux__)
+  if(int err = ::posix_fallocate(m_fd, off_t(offset), off_t(length)); err != 0)
+  {
+    errno = err;
+    return false;
+  }
+#else
+  if(::ftruncate(m_fd, off_t(offset + length)) != 0)
+    return false;
+#endif
+
+  void* map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, off_t(offset));
+  if(map == MAP_FAILED)
+  {
+    m_mapSize = 0;
+    return false;
+  }
+
+  m_map = static_cast<uint8_t*>(map);
+  m_mapOffset = offset;
+  m_mapSize = length;
+  return true;
+}
+
+bool CaptureWriter::append(
+    std::chrono::nanoseconds time, std::span<const std::span<const uint8_t>> parts)
+{
+  if(m_fd < 0)
+    return false;
+
+  std::size_t total = 0;
+  for(auto part : parts)
+    total += part.size();
+
+  const std::size_t bytes = align8(Capture::recordHeaderSize + total);
+  if(total == 0 || total > UINT32_MAX || !reserve(bytes))
+    return false;
+
+  uint8_t* record = m_map + (m_size - m_mapOffset);
+  uint8_t* p = record + Capture::recordHeaderSize;
+  for(auto part : parts)
+  {
+    if(part.empty())
+      continue;
+    std::memcpy(p, part.data(), part.size());
+    p += part.size();
+  }
+  store<uint64_t>(record, uint64_t(time.count()));
+  store<uint32_t>(record + 12, 0);
+
+  // The size goes last: if the process dies mid-record, the capture ends before it
+  std::atomic_signal_fence(std::memory_order_release);
+  store<uint32_t>(record + 8, uint32_t(total));
+
+  m_size += bytes;
+  return true;
+}
+
+// CaptureReader
+
+CaptureReader::~CaptureReader()
+{
+  if(m_map)
+    ::munmap(const_cast<uint8_t*>(m_map), m_size);
+}
+
+bool CaptureReader::open(const std::string& path)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0)
+    return false;
+
+  struct stat st{};
+  if(::fstat(fd, &st) != 0 || std::size_t(st.st_size) < Capture::headerSize)
+  {
+    ::close(fd);
+    errno = EINVAL;
+    return false;
+  }
+
+  // The mapping stays valid once the descriptor is closed
+  void* map = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(map == MAP_FAILED)
+    return false;
+
+  m_map = static_cast<const uint8_t*>(map);
+  m_size = std::size_t(st.st_size);
+  ::madvise(map, m_size, MADV_SEQUENTIAL);
+
+  const std::size_t start = load<uint32_t>(m_map + 12);
+  if(std::memcmp(m_map, Capture::magic, sizeof(Capture::magic)) != 0
+     || load<uint32_t>(m_map + 8) != Capture::version || start < Capture::headerSize
+     || start > m_size)
+  {
+    errno = EINVAL;
+    return false;
+  }
+  m_startTime = load<int64_t>(m_map + 16);
+
+  std::size_t pos = start;
+  while(pos + Capture::recordHeaderSize <= m_size)
+  {
+    const uint8_t* record = m_map + pos;
+    const uint32_t size = load<uint32_t>(record + 8);
+    if(size == 0)
+      break;
+
+    // A message must be complete and framed by its own size
+    const uint8_t* message = record + Capture::recordHeaderSize;
+    if(size < 4 || size > m_size - pos - Capture::recordHeaderSize
+       || (uint32_t(message[0]) << 24 | uint32_t(message[1]) << 16 | uint32_t(message[2]) << 8
+           | uint32_t(message[3]))
+              != size - 4)
+    {
+      m_truncated = true;
+      break;
+    }
+
+    m_records.push_back(
+        {std::chrono::nanoseconds{int64_t(load<uint64_t>(record))}, {message, size}});
+    pos += align8(Capture::recordHeaderSize + size);
+  }
+  return true;
+}
+
+// StreamRecorder
+
+StreamRecorder::StreamRecorder()
+    : m_copies(maxPending)
+{
+  // Register and Clear messages fit, larger ones grow their buffer once
+  for(std::size_t i = 0; i < m_copies.size(); i++)
+  {
+    m_copies[i].reserve(maxMessageOverhead);
+    m_freeCopies.push_back(int(i));
+  }
+  m_pending.reserve(maxPending);
+}
+
+StreamRecorder::~StreamRecorder()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    m_stopped = true;
+  }
+  m_wake.notify_one();
+  if(m_thread.joinable())
+    m_thread.join();
+
+  if(m_writer.isOpen())
+    qDebug() << "Hyperion: Capture closed," << m_written << "messages recorded," << m_skipped
+             << "skipped";
+  m_writer.close();
+}
+
+bool StreamRecorder::open(const std::string& path)
+{
+  if(!m_writer.open(path))
+    return false;
+
+  m_start = clock::now();
+  m_thread = std::thread{[this] { run(); }};
+  return true;
+}
+
+void StreamRecorder::append(std::shared_ptr<const EncodedFrame> frame)
+{
+  push({clock::now(), std::move(frame)});
+}
+
+void StreamRecorder::append(const EncodedFrame& frame)
+{
+  const auto time = clock::now();
+  int index{};
+  {
+    std::lock_guard lock{m_mutex};
+    if(m_stopped || m_freeCopies.empty())
+    {
+      m_skipped++;
+      return;
+    }
+    index = m_freeCopies.back();
+    m_freeCopies.pop_back();
+  }
+
+  // The buffer is ours until the writer gives it back
+  const auto body = frame.body();
+  auto& copy = m_copies[index];
+  copy.assign(frame.header.begin(), frame.header.end());
+  copy.insert(copy.end(), body.begin(), body.end());
+  push({time, nullptr, index});
+}
+
+uint64_t StreamRecorder::written() const noexcept
+{
+  std::lock_guard lock{m_mutex};
+  return m_written;
+}
+
+uint64_t StreamRecorder::skipped() const noexcept
+{
+  std::lock_guard lock{m_mutex};
+  return m_skipped;
+}
+
+void StreamRecorder::push(Entry entry)
+{
+  {
+    std::lock_guard lock{m_mutex};
+    if(m_stopped || m_pending.size() >= maxPending)
+    {
+      m_skipped++;
+      if(entry.copy >= 0)
+        m_freeCopies.push_back(entry.copy);
+      return;
+    }
+    m_pending.push_back(std::move(entry));
+  }
+  m_wake.notify_one();
+}
+
+void StreamRecorder::run()
+{
+  for(;;)
+  {
+    Entry entry;
+    {
+      std::unique_lock lock{m_mutex};
+      m_wake.wait(lock, [this] { return m_stopped || !m_pending.empty(); });
+      // What was sent before the link stopped still gets written
+      if(m_pending.empty())
+        return;
+
+      entry = std::move(m_pending.front());
+      m_pending.pop_front();
+    }
+
+    const std::span<const uint8_t> parts[2]{
+        entry.frame ? std::span<const uint8_t>{entry.frame->header}
+                    : std::span<const uint8_t>{m_copies[entry.copy]},
+        entry.frame ? entry.frame->body() : std::span<const uint8_t>{}};
+    const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(entry.time - m_start);
+
+    const bool ok = m_writer.append(time, parts);
+    // Hand the frame back to the pool before taking the lock again
+    entry.frame.reset();
+
+    std::lock_guard lock{m_mutex};
+    if(entry.copy >= 0)
+      m_freeCopies.push_back(entry.copy);
+    if(ok)
+    {
+      m_written++;
+    }
+    else
+    {
+      qWarning() << "Hyperion: Capture stopped, cannot write:" << strerror(errno);
+      m_skipped += 1 + m_pending.size();
+      m_pending.clear();
+      m_stopped = true;
+      return;
+    }
+  }
+}
+}
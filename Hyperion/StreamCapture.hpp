@@ -0,0 +1,155 @@
+#pragma once
+#include "RingQueue.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Hyperion
+{
+struct EncodedFrame;
+
+// Capture of the messages sent to Hyperion, exactly as they went on the wire.
+//
+// File layout, little-endian, records 8-byte aligned:
+//   header  "HYPCAP" 0 1, uint32 version, uint32 header size, int64 start (Unix time, ns)
+//   record  uint64 time since the start in ns, uint32 size, uint32 reserved,
+//           then `size` bytes: 4-byte big-endian size prefix and FlatBuffers Request
+// A record of size 0 ends the capture: the zero-filled space preallocated
+// after the last record of an interrupted recording reads as the end.
+namespace Capture
+{
+constexpr char magic[8]{'H', 'Y', 'P', 'C', 'A', 'P', 0, 1};
+constexpr uint32_t version = 1;
+constexpr std::size_t headerSize = 24;
+constexpr std::size_t recordHeaderSize = 16;
+}
+
+// Appends records to a capture file through a memory mapping, which is
+// grown in large steps. Not thread-safe, see StreamRecorder.
+class CaptureWriter
+{
+public:
+  CaptureWriter() = default;
+  ~CaptureWriter();
+
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+  // Truncates the file. Returns false with errno set on failure.
+  bool open(const std::string& path);
+  // Trims the preallocated space
+  void close();
+
+  bool isOpen() const noexcept { return m_fd >= 0; }
+  std::size_t size() const noexcept { return m_size; }
+
+  // The message is the concatenation of the parts
+  bool append(std::chrono::nanoseconds time, std::span<const std::span<const uint8_t>> parts);
+
+private:
+  bool reserve(std::size_t bytes);
+
+  int m_fd{-1};
+  uint8_t* m_map{};
+  std::size_t m_mapOffset{};
+  std::size_t m_mapSize{};
+  std::size_t m_size{}; // Written so far
+};
+
+// Read-only mapping of a capture file. The records point into the mapping.
+class CaptureReader
+{
+public:
+  struct Record
+  {
+    std::chrono::nanoseconds time;
+    // Size prefix and FlatBuffers Request, ready to be sent
+    std::span<const uint8_t> message;
+  };
+
+  CaptureReader() = default;
+  ~CaptureReader();
+
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  // Fails on a missing or foreign file. A truncated or corrupted tail only
+  // ends the records early, see truncated().
+  bool open(const std::string& path);
+
+  const std::vector<Record>& records() const noexcept { return m_records; }
+  // Unix time of the start of the recording, in ns
+  int64_t startTime() const noexcept { return m_startTime; }
+  bool truncated() const noexcept { return m_truncated; }
+
+private:
+  const uint8_t* m_map{};
+  std::size_t m_size{};
+  int64_t m_startTime{};
+  bool m_truncated{};
+  std::vector<Record> m_records;
+};
+
+// Records the frames of a link from its sender thread. Writes to the mapping
+// can stall on page faults and disk I/O, so they happen on a thread of their
+// own: the sender only queues a reference to the frame, and a frame is
+// skipped rather than stalling the sender when the writer falls behind.
+class StreamRecorder
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Frames waiting to be written, beyond which new ones are skipped
+  static constexpr std::size_t maxPending = 16;
+
+  StreamRecorder();
+  ~StreamRecorder();
+
+  StreamRecorder(const StreamRecorder&) = delete;
+  StreamRecorder& operator=(const StreamRecorder&) = delete;
+
+  bool open(const std::string& path);
+
+  // Sender thread, right after the frame was sent. Pooled frames are held
+  // until written, the others, Register and Clear, are copied into buffers
+  // allocated up front: queuing a frame does not touch the heap.
+  void append(std::shared_ptr<const EncodedFrame> frame);
+  void append(const EncodedFrame& frame);
+
+  uint64_t written() const noexcept;
+  uint64_t skipped() const noexcept;
+
+private:
+  struct Entry
+  {
+    clock::time_point time;
+    std::shared_ptr<const EncodedFrame> frame;
+    int copy{-1}; // Index in m_copies when the frame was copied
+  };
+
+  void push(Entry entry);
+  void run();
+
+  CaptureWriter m_writer;
+  clock::time_point m_start{};
+  std::thread m_thread;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+  RingQueue<Entry> m_pending;
+  // Copies of the messages not held by their frame, and the free ones
+  std::vector<std::vector<uint8_t>> m_copies;
+  std::vector<int> m_freeCopies;
+  bool m_stopped{};
+  uint64_t m_written{};
+  uint64_t m_skipped{};
+};
+}
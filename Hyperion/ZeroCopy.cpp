@@ -0,0 +1,143 @@
+#include "ZeroCopy.hpp"
+
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) \
+    && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define HYPERION_ZEROCOPY 1
+#endif
+
+namespace Hyperion
+{
+namespace
+{
+// When that many completions all report a deferred copy, as on loopback or
+// with NICs lacking scatter-gather, zero-copy only adds overhead
+constexpr uint64_t copiedProbe = 32;
+}
+
+bool ZeroCopyTracker::enable(int fd)
+{
+  reset();
+  m_zeroCopied = 0;
+  m_copied = 0;
+  m_enabled = false;
+#if defined(HYPERION_ZEROCOPY)
+  int one = 1;
+  m_enabled = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#endif
+  return m_enabled;
+}
+
+int ZeroCopyTracker::flags(std::size_t bytes) const noexcept
+{
+#if defined(HYPERION_ZEROCOPY)
+  if(m_enabled && bytes >= threshold)
+    return MSG_ZEROCOPY;
+#endif
+  return 0;
+}
+
+void ZeroCopyTracker::hold(std::shared_ptr<const void> frame)
+{
+  m_held.push_back({m_next, std::move(frame)});
+}
+
+int ZeroCopyTracker::reap(int fd)
+{
+  int count = 0;
+#if defined(HYPERION_ZEROCOPY)
+  for(;;)
+  {
+    alignas(cmsghdr) char control[128];
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if(::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      break;
+
+    for(cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+    {
+      const bool recvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                           || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+      if(!recvErr)
+        continue;
+
+      sock_extended_err err;
+      std::memcpy(&err, CMSG_DATA(cm), sizeof(err));
+      if(err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      // Sends [ee_info, ee_data] are done, TCP reports them in order
+      const uint32_t n = err.ee_data - err.ee_info + 1;
+      m_completed = err.ee_data + 1;
+      if(err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        m_copied += n;
+      else
+        m_zeroCopied += n;
+      count++;
+    }
+  }
+
+  while(!m_held.empty() && int32_t(m_completed - m_held.front().end) >= 0)
+    m_held.pop_front();
+
+  if(m_enabled && m_zeroCopied == 0 && m_copied >= copiedProbe)
+  {
+    qDebug() << "Hyperion: The kernel copies zero-copy sends on this route, using regular sends";
+    m_enabled = false;
+  }
+#endif
+  return count;
+}
+
+void ZeroCopyTracker::drain(int fd, std::chrono::milliseconds timeout)
+{
+#if defined(HYPERION_ZEROCOPY)
+  using clock = std::chrono::steady_clock;
+  const auto deadline = clock::now() + timeout;
+  reap(fd);
+  while(!m_held.empty())
+  {
+    const auto remaining
+        = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now());
+    if(remaining.count() <= 0)
+      break;
+
+    // Completions are signaled as POLLERR
+    pollfd pfd{fd, 0, 0};
+    const int r = ::poll(&pfd, 1, int(remaining.count()));
+    if(r < 0 && errno == EINTR)
+      continue;
+    // Nothing came, or a real error or hang-up: they will not come anymore
+    if(r <= 0 || reap(fd) == 0)
+      break;
+  }
+
+  if(!m_held.empty())
+  {
+    linger abort{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+  }
+#endif
+}
+
+void ZeroCopyTracker::reset()
+{
+  // Only once the socket is closed, after drain(): nothing reads the pages anymore
+  m_held.clear();
+  m_next = 0;
+  m_completed = 0;
+}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "RingQueue.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Hyperion
+{
+// Keeps the frames sent with MSG_ZEROCOPY alive until the kernel reports,
+// through the socket error queue, that it no longer reads their pages.
+// Holding a reference is enough to keep a frame out of its FramePool.
+// Linux only: elsewhere, or when the socket does not support it, enable()
+// fails and frames are sent with a regular copy.
+class ZeroCopyTracker
+{
+public:
+  // Below this size the page pinning and the completion costs more than the copy
+  static constexpr std::size_t threshold = 32 * 1024;
+
+  // Sets SO_ZEROCOPY on a newly connected socket
+  bool enable(int fd);
+  bool enabled() const noexcept { return m_enabled; }
+
+  // Flags to add to sendmsg() for a message of `bytes`
+  int flags(std::size_t bytes) const noexcept;
+
+  // Counts a successful sendmsg() done with MSG_ZEROCOPY
+  void sent() noexcept { m_next++; }
+
+  // `frame` stays referenced until every send done so far has completed
+  void hold(std::shared_ptr<const void> frame);
+
+  // Reads the pending completions without blocking and releases the frames
+  // they cover. Returns the number of notifications read.
+  int reap(int fd);
+
+  // Before the socket is closed: the kernel goes on sending the queued data
+  // from the pages of the frames after close(). Waits up to `timeout` for
+  // their completions, and if some are still missing, makes close() reset the
+  // connection so that the queued data is discarded instead of sent.
+  void drain(int fd, std::chrono::milliseconds timeout);
+
+  // The socket is closed, its completions will never come
+  void reset();
+
+  std::size_t pending() const noexcept { return m_held.size(); }
+  // Sends which completed without, or with, a deferred kernel copy
+  uint64_t zeroCopied() const noexcept { return m_zeroCopied; }
+  uint64_t copied() const noexcept { return m_copied; }
+
+private:
+  struct Held
+  {
+    uint32_t end;
+    std::shared_ptr<const void> frame;
+  };
+
+  RingQueue<Held> m_held;
+  // Identifier of the next zero-copy send, and of the first one not yet completed
+  uint32_t m_next{};
+  uint32_t m_completed{};
+  uint64_t m_zeroCopied{};
+  uint64_t m_copied{};
+  bool m_enabled{};
+};
+}
@@ -0,0 +1,232 @@
+// Once warmed up, the path from a rendered frame to the socket must not
+// allocate. Every heap allocation of the process is counted, C++ or C: malloc
+// and its siblings are interposed, which also covers operator new and the
+// Qt containers. The mock server runs in a child process so that it does not
+// count, and frames are posted one at a time, each waiting for its reply, so
+// that the same work is done on every run whatever the timing.
+
+#include "../tools/mock/MockServer.hpp"
+
+#include <Hyperion/HyperionConnection.hpp>
+#include <Hyperion/OutputSettings.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Hyperion;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+constexpr int skipped = 77;
+
+std::atomic_bool counting{false};
+std::atomic<uint64_t> allocations{0};
+
+void countAllocation() noexcept
+{
+  if(counting.load(std::memory_order_relaxed))
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* p);
+
+void* malloc(std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_realloc(p, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, std::size_t alignment, std::size_t size) noexcept
+{
+  countAllocation();
+  *p = __libc_memalign(alignment, size);
+  return *p || size == 0 ? 0 : ENOMEM;
+}
+
+void free(void* p) noexcept
+{
+  __libc_free(p);
+}
+}
+#endif
+
+namespace
+{
+constexpr int warmUpFrames = 100;
+constexpr int measuredFrames = 300;
+constexpr auto replyTimeout = std::chrono::seconds{2};
+
+struct Resolution
+{
+  int width{};
+  int height{};
+};
+
+// Waits until everything the output sent was acknowledged
+bool waitForReplies(const HyperionConnection& output, uint64_t sent)
+{
+  const auto deadline = clock_type::now() + replyTimeout;
+  for(;;)
+  {
+    const auto stats = output.statistics();
+    if(stats.sent >= sent && stats.inFlight == 0)
+      return true;
+    if(clock_type::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::microseconds{100});
+  }
+}
+
+// Three outputs sharing a connection, two with the same priority, send
+// color-corrected images, which are converted in row bands at 1080p, and solid
+// colors. The connection registers again at every switch of priority.
+// Returns the allocations counted over the measured frames, -1 on failure.
+int64_t run(int port, Resolution res)
+{
+  OutputSettings settings;
+  settings.port = port;
+  settings.rate = 1000.;
+  settings.brightness = 90;
+  settings.gamma = 1.2;
+
+  std::vector<std::unique_ptr<HyperionConnection>> outputs;
+  for(int priority : {150, 150, 151})
+  {
+    settings.priority = priority;
+    outputs.push_back(std::make_unique<HyperionConnection>(settings));
+  }
+
+  const auto connectDeadline = clock_type::now() + replyTimeout;
+  for(const auto& output : outputs)
+    while(!output->isConnected() && clock_type::now() < connectDeadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+  std::vector<uint8_t> image(std::size_t(res.width) * res.height * 4);
+  for(std::size_t i = 0; i < image.size(); i++)
+    image[i] = uint8_t(i * 7 + i / 4096);
+  const std::vector<uint8_t> color(image.size(), 0x40);
+
+  std::vector<uint64_t> sent(outputs.size());
+  for(int frame = 0; frame < warmUpFrames + measuredFrames; frame++)
+  {
+    if(frame == warmUpFrames)
+    {
+      allocations = 0;
+      counting = true;
+    }
+
+    // Every frame differs from the previous one of its output, none is deduplicated
+    const std::size_t index = frame % outputs.size();
+    image[0] = uint8_t(frame);
+    const auto& pixels = frame % 5 == 4 ? color : image;
+    outputs[index]->sendImage(pixels.data(), res.width, res.height, -1, clock_type::now());
+
+    if(!waitForReplies(*outputs[index], ++sent[index]))
+    {
+      counting = false;
+      std::fprintf(
+          stderr, "%dx%d: frame %d not acknowledged\n", res.width, res.height, frame);
+      return -1;
+    }
+  }
+  counting = false;
+  return int64_t(allocations.load());
+}
+}
+
+int main()
+{
+#if !defined(__GLIBC__)
+  std::printf("Allocations can only be counted with glibc, skipped\n");
+  return skipped;
+#endif
+
+  // The server is started before any thread, in a process of its own
+  int portPipe[2];
+  if(::pipe(portPipe) != 0)
+    return 1;
+
+  const pid_t server = ::fork();
+  if(server < 0)
+    return 1;
+  if(server == 0)
+  {
+    ::close(portPipe[0]);
+    MockServer mock{MockServer::Options{.port = 0}};
+    const int port = mock.start() ? mock.port() : -1;
+    [[maybe_unused]] auto res = ::write(portPipe[1], &port, sizeof(port));
+    // Serves until the test is done with it
+    for(;;)
+      ::pause();
+  }
+
+  ::close(portPipe[1]);
+  int port = -1;
+  if(::read(portPipe[0], &port, sizeof(port)) != sizeof(port) || port <= 0)
+  {
+    std::fprintf(stderr, "Cannot start the mock server\n");
+    ::kill(server, SIGTERM);
+    ::waitpid(server, nullptr, 0);
+    return 1;
+  }
+
+  int failures = 0;
+  for(auto res : {Resolution{160, 90}, Resolution{1920, 1080}})
+  {
+    const int64_t counted = run(port, res);
+    if(counted != 0)
+      failures++;
+    if(counted > 0)
+      std::fprintf(
+          stderr, "%dx%d: %lld allocations in %d frames\n", res.width, res.height,
+          (long long)counted, measuredFrames);
+  }
+
+  ::kill(server, SIGTERM);
+  ::waitpid(server, nullptr, 0);
+
+  std::printf("%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
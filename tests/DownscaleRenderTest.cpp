@@ -0,0 +1,220 @@
+// Renders DownscaleRenderer's shaders with QRhi's OpenGL backend, e.g. on
+// Mesa's llvmpipe without a GPU nor a display, and compares the readback with
+// a CPU reference of the flip and box average. Exits with 77, counted as
+// skipped by ctest, when no OpenGL implementation is available.
+
+#include <Hyperion/DownscaleShader.hpp>
+
+#include <QGuiApplication>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QtGui/private/qrhigles2_p.h>
+#include <QtShaderTools/private/qshaderbaker_p.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr int skipped = 77;
+
+struct Case
+{
+  QSize src;
+  QSize dst;
+};
+
+QShader bake(QShader::Stage stage, const char* source)
+{
+  QShaderBaker baker;
+  baker.setGeneratedShaderVariants({QShader::StandardShader});
+  baker.setGeneratedShaders(
+      {{QShader::GlslShader, QShaderVersion{330}},
+       {QShader::GlslShader, QShaderVersion{300, QShaderVersion::GlslEs}}});
+  baker.setSourceString(source, stage);
+  QShader shader = baker.bake();
+  if(!shader.isValid())
+    std::fprintf(stderr, "Shader: %s\n", qPrintable(baker.errorMessage()));
+  return shader;
+}
+
+// What the fragment shader computes, in texture memory rows
+std::vector<uint8_t>
+reference(const std::vector<uint8_t>& src, QSize srcSize, QSize dstSize, bool flip)
+{
+  std::vector<uint8_t> res(std::size_t(dstSize.width()) * dstSize.height() * 4);
+  for(int oy = 0; oy < dstSize.height(); oy++)
+  {
+    const int y0 = oy * srcSize.height() / dstSize.height();
+    const int y1 = std::max(y0 + 1, (oy + 1) * srcSize.height() / dstSize.height());
+    for(int ox = 0; ox < dstSize.width(); ox++)
+    {
+      const int x0 = ox * srcSize.width() / dstSize.width();
+      const int x1 = std::max(x0 + 1, (ox + 1) * srcSize.width() / dstSize.width());
+
+      double sum[4]{};
+      for(int y = y0; y < y1; y++)
+      {
+        const int sy = flip ? srcSize.height() - 1 - y : y;
+        for(int x = x0; x < x1; x++)
+          for(int c = 0; c < 4; c++)
+            sum[c] += src[(std::size_t(sy) * srcSize.width() + x) * 4 + c];
+      }
+
+      const double count = double(x1 - x0) * (y1 - y0);
+      for(int c = 0; c < 4; c++)
+        res[(std::size_t(oy) * dstSize.width() + ox) * 4 + c]
+            = uint8_t(std::lround(sum[c] / count));
+    }
+  }
+  return res;
+}
+
+// Returns the number of mismatching bytes, -1 if the frame could not be rendered
+int run(QRhi& rhi, const QShader& vertex, const QShader& fragment, Case c)
+{
+  std::vector<uint8_t> pixels(std::size_t(c.src.width()) * c.src.height() * 4);
+  std::mt19937 rng{uint32_t(c.src.width() * 31 + c.dst.width())};
+  for(auto& b : pixels)
+    b = uint8_t(rng());
+  const QImage image{
+      pixels.data(), c.src.width(), c.src.height(), QImage::Format_RGBA8888};
+
+  std::unique_ptr<QRhiTexture> src{rhi.newTexture(QRhiTexture::RGBA8, c.src)};
+  std::unique_ptr<QRhiTexture> dst{rhi.newTexture(
+      QRhiTexture::RGBA8, c.dst, 1,
+      QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource)};
+  src->create();
+  dst->create();
+
+  std::unique_ptr<QRhiTextureRenderTarget> rt{rhi.newTextureRenderTarget({dst.get()})};
+  std::unique_ptr<QRhiRenderPassDescriptor> rp{rt->newCompatibleRenderPassDescriptor()};
+  rt->setRenderPassDescriptor(rp.get());
+  rt->create();
+
+  // Same resources as DownscaleRenderer::init
+  std::unique_ptr<QRhiBuffer> ubo{rhi.newBuffer(
+      QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(Hyperion::DownscaleParams))};
+  ubo->create();
+  std::unique_ptr<QRhiSampler> sampler{rhi.newSampler(
+      QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None,
+      QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge)};
+  sampler->create();
+
+  std::unique_ptr<QRhiShaderResourceBindings> srb{rhi.newShaderResourceBindings()};
+  srb->setBindings(
+      {QRhiShaderResourceBinding::uniformBuffer(
+           0, QRhiShaderResourceBinding::FragmentStage, ubo.get()),
+       QRhiShaderResourceBinding::sampledTexture(
+           1, QRhiShaderResourceBinding::FragmentStage, src.get(), sampler.get())});
+  srb->create();
+
+  std::unique_ptr<QRhiGraphicsPipeline> pipeline{rhi.newGraphicsPipeline()};
+  pipeline->setShaderStages(
+      {{QRhiShaderStage::Vertex, vertex}, {QRhiShaderStage::Fragment, fragment}});
+  pipeline->setVertexInputLayout({});
+  pipeline->setShaderResourceBindings(srb.get());
+  pipeline->setRenderPassDescriptor(rp.get());
+  if(!pipeline->create())
+    return -1;
+
+  const bool flip = rhi.isYUpInFramebuffer();
+  const auto params = Hyperion::DownscaleParams::make(
+      c.src.width(), c.src.height(), c.dst.width(), c.dst.height(), flip);
+
+  QRhiCommandBuffer* cb{};
+  if(rhi.beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess)
+    return -1;
+
+  auto res = rhi.nextResourceUpdateBatch();
+  res->uploadTexture(src.get(), image);
+  res->updateDynamicBuffer(ubo.get(), 0, sizeof(params), &params);
+
+  cb->beginPass(rt.get(), Qt::black, {1.0f, 0}, res);
+  cb->setGraphicsPipeline(pipeline.get());
+  cb->setShaderResources(srb.get());
+  cb->setViewport(QRhiViewport(0, 0, c.dst.width(), c.dst.height()));
+  cb->draw(3);
+
+  QRhiReadbackResult readback;
+  auto next = rhi.nextResourceUpdateBatch();
+  next->readBackTexture(QRhiReadbackDescription{dst.get()}, &readback);
+  cb->endPass(next);
+
+  // Offscreen frames are waited for, the readback is complete
+  rhi.endOffscreenFrame();
+
+  const auto expected = reference(pixels, c.src, c.dst, flip);
+  if(std::size_t(readback.data.size()) != expected.size())
+    return int(expected.size());
+
+  // The GPU may round the average either way
+  int mismatches = 0;
+  for(std::size_t i = 0; i < expected.size(); i++)
+    if(std::abs(int(uint8_t(readback.data[i])) - int(expected[i])) > 1)
+      mismatches++;
+  return mismatches;
+}
+}
+
+int main(int argc, char** argv)
+{
+  // Software rendering, without a display
+  if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QGuiApplication app{argc, argv};
+
+  std::unique_ptr<QOffscreenSurface> surface{QRhiGles2InitParams::newFallbackSurface()};
+  QRhiGles2InitParams params;
+  params.fallbackSurface = surface.get();
+  // texelFetch and integer arithmetic need GLSL 3.30
+  params.format.setVersion(3, 3);
+  params.format.setProfile(QSurfaceFormat::CoreProfile);
+
+  std::unique_ptr<QRhi> rhi{QRhi::create(QRhi::OpenGLES2, &params)};
+  if(!rhi)
+  {
+    std::printf("No OpenGL implementation available, skipped\n");
+    return skipped;
+  }
+  std::printf(
+      "Renderer: %s, Y up in framebuffer: %d\n", rhi->driverInfo().deviceName.constData(),
+      int(rhi->isYUpInFramebuffer()));
+
+  const QShader vertex = bake(QShader::VertexStage, Hyperion::downscaleVertexShader);
+  const QShader fragment = bake(QShader::FragmentStage, Hyperion::downscaleFragmentShader);
+  if(!vertex.isValid() || !fragment.isValid())
+    return 1;
+
+  // Exact blocks, uneven blocks, a single pixel and a typical send resolution
+  const Case cases[]{
+      {{64, 36}, {16, 9}},
+      {{37, 23}, {10, 7}},
+      {{5, 3}, {1, 1}},
+      {{1280, 720}, {160, 90}}};
+
+  int failures = 0;
+  for(const auto& c : cases)
+  {
+    const int mismatches = run(*rhi, vertex, fragment, c);
+    if(mismatches != 0)
+    {
+      failures++;
+      std::fprintf(
+          stderr, "%dx%d to %dx%d: ", c.src.width(), c.src.height(), c.dst.width(),
+          c.dst.height());
+      if(mismatches < 0)
+        std::fprintf(stderr, "render failed\n");
+      else
+        std::fprintf(stderr, "%d bytes differ from the reference\n", mismatches);
+    }
+  }
+
+  std::printf("%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// An image encoded by rewriting the pixels of the previous message must give
+// the same bytes as a full encoding, and pass the FlatBuffers verifier. One
+// frame goes through a series of images: each one with the parameters of the
+// previous one is patched in place, any other size or duration, or an image
+// after a color, is encoded again from CreateUninitializedVector.
+
+#include <Hyperion/FrameEncoder.hpp>
+#include <Hyperion/PixelConversion.hpp>
+#include <Hyperion/RowBandPool.hpp>
+
+#include "hyperion_request_generated.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Hyperion;
+
+namespace
+{
+int failures = 0;
+
+struct Step
+{
+  int width{};
+  int height{};
+  int duration{};
+  // Whether the previous message has the same layout, so that it is patched
+  bool patched{};
+  // A Color command replaces the previous image before this one
+  bool afterColor{};
+  bool lut{};
+};
+
+// The 1080p images are large enough to be converted in several bands
+const Step steps[]{
+    // The first image grows the builder from its small initial capacity
+    {160, 90, -1, false},
+    {160, 90, -1, true},
+    // Size change: larger, then smaller
+    {161, 91, -1, false},
+    {161, 91, -1, true},
+    {7, 3, -1, false},
+    // Duration change
+    {7, 3, 3000, false},
+    {7, 3, 3000, true},
+    {7, 3, -1, false},
+    // A color resets the layout, whatever the size of the next image
+    {7, 3, -1, false, true},
+    {7, 3, -1, true},
+    {1920, 1080, 1000, false, false, true},
+    {1920, 1080, 1000, true, false, true},
+    {1, 1, 1000, false},
+};
+
+void check(bool ok, std::size_t step, const Step& s, const char* what)
+{
+  if(ok)
+    return;
+  failures++;
+  std::fprintf(
+      stderr, "step %zu, %dx%d, duration %d: %s\n", step, s.width, s.height, s.duration,
+      what);
+}
+
+std::vector<uint8_t> randomImage(const Step& s, uint32_t seed)
+{
+  std::vector<uint8_t> img(std::size_t(s.width) * s.height * 4);
+  std::mt19937 rng{seed};
+  for(auto& b : img)
+    b = uint8_t(rng());
+  return img;
+}
+
+// The decoded message carries the parameters and the converted pixels
+bool decodesTo(
+    const EncodedFrame& frame, const Step& s, const std::vector<uint8_t>& rgb)
+{
+  const auto body = frame.body();
+  flatbuffers::Verifier verifier{body.data(), body.size()};
+  if(!hyperionnet::VerifyRequestBuffer(verifier))
+    return false;
+
+  const auto* image = hyperionnet::GetRequest(body.data())->command_as_Image();
+  const auto* raw = image ? image->data_as_RawImage() : nullptr;
+  if(!raw || !raw->data() || image->duration() != s.duration || raw->width() != s.width
+     || raw->height() != s.height)
+    return false;
+  return std::equal(raw->data()->begin(), raw->data()->end(), rgb.begin(), rgb.end());
+}
+}
+
+int main()
+{
+  const auto lut = ColorLut::make(0.8, 2.2, 1., 0.9, 0.7);
+  RowBandPool bands{4};
+
+  // Small on purpose: the builder reallocates while the pixels are written
+  EncodedFrame patched{64};
+  for(std::size_t i = 0; i < std::size(steps); i++)
+  {
+    const auto& s = steps[i];
+    if(s.afterColor)
+      encodeColor(patched, 0x102030, s.width, s.height, s.duration);
+
+    const auto rgba = randomImage(s, uint32_t(i));
+    const std::size_t pixels = std::size_t(s.width) * s.height;
+    std::vector<uint8_t> rgb(pixels * 3);
+    if(s.lut)
+      rgbaToRgbLutScalar(rgba.data(), rgb.data(), pixels, lut);
+    else
+      rgbaToRgbScalar(rgba.data(), rgb.data(), pixels);
+
+    // Patching leaves the message where it is
+    const auto before = patched.body();
+    encodeImage(
+        patched, rgba.data(), s.width, s.height, s.duration, nullptr, &bands,
+        s.lut ? &lut : nullptr);
+    const auto after = patched.body();
+    if(s.patched)
+      check(
+          before.data() == after.data() && before.size() == after.size(), i, s,
+          "not patched in place");
+
+    EncodedFrame full;
+    encodeImage(
+        full, rgba.data(), s.width, s.height, s.duration, nullptr, nullptr,
+        s.lut ? &lut : nullptr);
+
+    check(
+        patched.header == full.header
+            && std::equal(after.begin(), after.end(), full.body().begin(), full.body().end()),
+        i, s, "differs from a full encoding");
+    check(decodesTo(full, s, rgb), i, s, "full encoding does not decode to the image");
+    check(decodesTo(patched, s, rgb), i, s, "does not decode to the image");
+    check(
+        patched.color == -1 && patched.width == s.width && patched.height == s.height, i, s,
+        "wrong frame parameters");
+  }
+
+  std::printf("%zu images, %d failure(s)\n", std::size(steps), failures);
+  return failures == 0 ? 0 : 1;
+}
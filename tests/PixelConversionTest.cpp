@@ -0,0 +1,103 @@
+// Every RGBA to RGB kernel usable on this CPU must produce the same bytes as
+// the scalar reference for every pixel count around the vector widths, and
+// write neither before nor after the destination.
+
+#include <Hyperion/PixelConversion.hpp>
+
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace Hyperion;
+
+namespace
+{
+constexpr std::size_t maxPixels = 300;
+constexpr std::size_t guard = 64;
+constexpr uint8_t guardByte = 0xA5;
+
+int failures = 0;
+
+// Destination with guard bytes on both sides, `pixels` RGB pixels in the middle
+struct Output
+{
+  explicit Output(std::size_t pixels)
+      : bytes(guard + pixels * 3 + guard, guardByte)
+  {
+  }
+
+  uint8_t* data() noexcept { return bytes.data() + guard; }
+
+  bool guardsIntact(std::size_t pixels) const noexcept
+  {
+    for(std::size_t i = 0; i < guard; i++)
+      if(bytes[i] != guardByte || bytes[guard + pixels * 3 + i] != guardByte)
+        return false;
+    return true;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+void check(bool ok, const char* kernel, std::size_t pixels, const char* what)
+{
+  if(ok)
+    return;
+  failures++;
+  std::fprintf(stderr, "%s, %zu pixels: %s\n", kernel, pixels, what);
+}
+
+void testPixels(std::size_t pixels, const ColorLut& lut)
+{
+  // Unaligned source, as a readback row can be
+  std::vector<uint8_t> buffer(1 + pixels * 4);
+  std::mt19937 rng{uint32_t(pixels)};
+  for(auto& b : buffer)
+    b = uint8_t(rng());
+  const uint8_t* src = buffer.data() + 1;
+
+  Output expected{pixels};
+  rgbaToRgbScalar(src, expected.data(), pixels);
+  check(expected.guardsIntact(pixels), "scalar", pixels, "guard bytes overwritten");
+
+  for(const auto& kernel : availableRgbaToRgbKernels())
+  {
+    Output actual{pixels};
+    kernel.convert(src, actual.data(), pixels);
+    check(actual.bytes == expected.bytes, kernel.name, pixels, "differs from scalar");
+  }
+
+  Output dispatched{pixels};
+  rgbaToRgb(src, dispatched.data(), pixels);
+  check(dispatched.bytes == expected.bytes, "dispatch", pixels, "differs from scalar");
+
+  Output lutReference{pixels};
+  rgbaToRgbLutScalar(src, lutReference.data(), pixels, lut);
+  check(lutReference.guardsIntact(pixels), "lut-scalar", pixels, "guard bytes overwritten");
+
+  Output lutActual{pixels};
+  rgbaToRgbLut(src, lutActual.data(), pixels, lut);
+  check(lutActual.bytes == lutReference.bytes, "lut", pixels, "differs from scalar");
+
+  // The identity table is the plain conversion
+  if(lut.isIdentity())
+    check(lutReference.bytes == expected.bytes, "lut-identity", pixels, "differs from scalar");
+}
+}
+
+int main()
+{
+  const ColorLut luts[]{
+      ColorLut::make(1., 1., 1., 1., 1.), ColorLut::make(0.8, 2.2, 1., 0.9, 0.7)};
+
+  for(const auto& lut : luts)
+    for(std::size_t pixels = 0; pixels <= maxPixels; pixels++)
+      testPixels(pixels, lut);
+
+  std::printf("kernels:");
+  for(const auto& kernel : availableRgbaToRgbKernels())
+    std::printf(" %s", kernel.name);
+  std::printf("\n%d failure(s)\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,641 @@
+// Benchmark of the Hyperion output pipeline, independent of score:
+// RGBA to RGB conversion, FlatBuffers Image encoding, framed send over
+// loopback TCP or a Unix domain socket and the whole HyperionConnection path.
+// Results are printed as one JSON object per line.
+
+#include <Hyperion/FrameEncoder.hpp>
+#include <Hyperion/HyperionConnection.hpp>
+#include <Hyperion/LedSampler.hpp>
+#include <Hyperion/OutputSettings.hpp>
+#include <Hyperion/PixelConversion.hpp>
+#include <Hyperion/RowBandPool.hpp>
+#include <Hyperion/ZeroCopy.hpp>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace Hyperion;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+struct Resolution
+{
+  int width;
+  int height;
+};
+
+constexpr Resolution resolutions[]{
+    {160, 90}, {320, 180}, {640, 360}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+
+std::chrono::milliseconds minTime{200};
+// Drain server on another machine for the send benchmark, e.g. the mock server
+QString remoteHost;
+int remotePort{};
+FILE* output = stdout;
+
+void emit(QJsonObject obj)
+{
+  const auto line = QJsonDocument{obj}.toJson(QJsonDocument::Compact);
+  std::fwrite(line.constData(), 1, line.size(), output);
+  std::fputc('\n', output);
+  std::fflush(output);
+}
+
+// Runs `f` until minTime has elapsed and at least 10 times, reports per-iteration statistics
+void measure(
+    const char* benchmark, const char* variant, Resolution res, std::size_t bytes,
+    const std::function<void()>& f)
+{
+  f(); // Warm-up
+
+  std::vector<double> samples;
+  const auto end = clock_type::now() + minTime;
+  while(samples.size() < 10 || clock_type::now() < end)
+  {
+    const auto t0 = clock_type::now();
+    f();
+    const auto t1 = clock_type::now();
+    samples.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+  }
+
+  std::sort(samples.begin(), samples.end());
+  double total = 0.;
+  for(double s : samples)
+    total += s;
+  const double mean = total / samples.size();
+  auto percentile = [&](double p) {
+    return samples[std::min(samples.size() - 1, std::size_t(p * samples.size()))];
+  };
+
+  emit(
+      {{"benchmark", benchmark},
+       {"variant", variant},
+       {"width", res.width},
+       {"height", res.height},
+       {"iterations", qint64(samples.size())},
+       {"mean_us", mean},
+       {"min_us", samples.front()},
+       {"p50_us", percentile(0.5)},
+       {"p99_us", percentile(0.99)},
+       {"mb_per_s", double(bytes) / mean}});
+}
+
+std::vector<uint8_t> randomImage(Resolution res)
+{
+  std::vector<uint8_t> img(std::size_t(res.width) * res.height * 4);
+  std::mt19937 rng{1234};
+  for(auto& b : img)
+    b = uint8_t(rng());
+  return img;
+}
+
+// Every kernel must produce the same bytes as the scalar reference, including odd sizes
+bool validateKernels()
+{
+  bool ok = true;
+  const std::size_t sizes[]{0, 1, 7, 15, 16, 17, 31, 33, 63, 65, 1000, 160 * 90, 1920 * 1080};
+  for(std::size_t pixels : sizes)
+  {
+    std::vector<uint8_t> src(pixels * 4);
+    std::mt19937 rng{uint32_t(pixels)};
+    for(auto& b : src)
+      b = uint8_t(rng());
+
+    // Guard bytes after the destination catch overruns
+    std::vector<uint8_t> expected(pixels * 3 + 64, 0xA5);
+    rgbaToRgbScalar(src.data(), expected.data(), pixels);
+
+    for(const auto& kernel : availableRgbaToRgbKernels())
+    {
+      std::vector<uint8_t> actual(pixels * 3 + 64, 0xA5);
+      kernel.convert(src.data(), actual.data(), pixels);
+      const bool same = actual == expected;
+      if(!same)
+      {
+        ok = false;
+        emit(
+            {{"benchmark", "validate"},
+             {"variant", kernel.name},
+             {"pixels", qint64(pixels)},
+             {"ok", false}});
+      }
+    }
+
+    // The identity table gives the plain conversion, any other one the reference
+    const ColorLut luts[]{
+        ColorLut::make(1., 1., 1., 1., 1.), ColorLut::make(0.8, 2.2, 1., 0.9, 0.7)};
+    for(const auto& lut : luts)
+    {
+      std::vector<uint8_t> reference(pixels * 3 + 64, 0xA5);
+      rgbaToRgbLutScalar(src.data(), reference.data(), pixels, lut);
+      std::vector<uint8_t> actual(pixels * 3 + 64, 0xA5);
+      rgbaToRgbLut(src.data(), actual.data(), pixels, lut);
+      if(actual != reference || (lut.isIdentity() && reference != expected))
+      {
+        ok = false;
+        emit(
+            {{"benchmark", "validate"},
+             {"variant", lut.isIdentity() ? "lut-identity" : "lut"},
+             {"pixels", qint64(pixels)},
+             {"ok", false}});
+      }
+    }
+  }
+  return ok;
+}
+
+// Uniform images are detected whatever the tail length, a single differing pixel is not
+bool validateUniform()
+{
+  bool ok = true;
+  const std::size_t sizes[]{2, 7, 15, 16, 17, 33, 4095, 4097, 160 * 90, 1920 * 1080};
+  for(std::size_t pixels : sizes)
+  {
+    std::vector<uint8_t> img(pixels * 4);
+    for(std::size_t i = 0; i < pixels; i++)
+    {
+      // Within a tolerance of 2, alpha is ignored
+      img[i * 4 + 0] = uint8_t(10 + i % 3);
+      img[i * 4 + 1] = 200;
+      img[i * 4 + 2] = 50;
+      img[i * 4 + 3] = uint8_t(i);
+    }
+
+    const auto solid = uniformColor(img.data(), pixels, 2);
+    img[(pixels - 1) * 4 + 2] = 60;
+    const auto varying = uniformColor(img.data(), pixels, 2);
+
+    // Middle of each channel range: 11, 200, 50
+    if(solid != 0x0BC832u || varying)
+    {
+      ok = false;
+      emit(
+          {{"benchmark", "validate"},
+           {"variant", "uniform"},
+           {"pixels", qint64(pixels)},
+           {"ok", false}});
+    }
+  }
+  return ok;
+}
+
+enum class Transport
+{
+  Tcp,
+  Unix
+};
+
+const char* transportName(Transport t)
+{
+  return t == Transport::Tcp ? "tcp" : "unix";
+}
+
+// Accepts one connection on an ephemeral loopback port or a temporary
+// Unix domain socket and discards everything it receives
+class DrainServer
+{
+public:
+  explicit DrainServer(Transport transport = Transport::Tcp)
+  {
+    if(transport == Transport::Unix)
+    {
+      m_path = QString{"/tmp/score_addon_hyperion_bench_%1.sock"}
+                   .arg(QCoreApplication::applicationPid())
+                   .toStdString();
+      ::unlink(m_path.c_str());
+
+      m_listen = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      const auto addr = unixAddress();
+      ::bind(m_listen, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    }
+    else
+    {
+      m_listen = ::socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      ::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+      socklen_t len = sizeof(addr);
+      ::getsockname(m_listen, reinterpret_cast<sockaddr*>(&addr), &len);
+      m_port = ntohs(addr.sin_port);
+    }
+    ::listen(m_listen, 1);
+
+    m_thread = std::thread{[this] {
+      const int fd = ::accept(m_listen, nullptr, nullptr);
+      if(fd < 0)
+        return;
+      std::vector<uint8_t> buf(1 << 20);
+      while(::recv(fd, buf.data(), buf.size(), 0) > 0)
+        ;
+      ::close(fd);
+    }};
+  }
+
+  ~DrainServer()
+  {
+    // Unblocks accept() if nobody connected
+    ::shutdown(m_listen, SHUT_RDWR);
+    m_thread.join();
+    ::close(m_listen);
+    if(!m_path.empty())
+      ::unlink(m_path.c_str());
+  }
+
+  int port() const noexcept { return m_port; }
+  // Empty for TCP
+  const std::string& path() const noexcept { return m_path; }
+
+  // Connected with the same socket options as HyperionLink
+  int connect() const
+  {
+    const bool local = !m_path.empty();
+    const int fd = ::socket(local ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+    int sndbuf = 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    int res{};
+    if(local)
+    {
+      const auto addr = unixAddress();
+      res = ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    }
+    else
+    {
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(m_port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      res = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+
+    if(res < 0)
+    {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+private:
+  sockaddr_un unixAddress() const
+  {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, m_path.c_str(), m_path.size() + 1);
+    return addr;
+  }
+
+  int m_listen{-1};
+  int m_port{};
+  std::string m_path;
+  std::thread m_thread;
+};
+
+int connectRemote()
+{
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  int sndbuf = 1024 * 1024;
+  ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(remotePort);
+  if(inet_pton(AF_INET, remoteHost.toStdString().c_str(), &addr.sin_addr) <= 0
+     || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Same framing as HyperionLink: size prefix and body in one sendmsg,
+// with MSG_ZEROCOPY when a tracker is given
+bool sendFramed(int fd, const EncodedFrame& frame, ZeroCopyTracker* zeroCopy = nullptr)
+{
+  int flags = MSG_NOSIGNAL;
+#if defined(MSG_ZEROCOPY)
+  if(zeroCopy)
+    flags |= MSG_ZEROCOPY;
+#endif
+
+  const auto body = frame.body();
+  iovec iov[2]{
+      {const_cast<uint8_t*>(frame.header.data()), frame.header.size()},
+      {const_cast<uint8_t*>(body.data()), body.size()}};
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  while(msg.msg_iovlen > 0)
+  {
+    ssize_t n = ::sendmsg(fd, &msg, flags);
+    if(n < 0)
+      return false;
+    if(zeroCopy)
+      zeroCopy->sent();
+    while(msg.msg_iovlen > 0 && size_t(n) >= msg.msg_iov->iov_len)
+    {
+      n -= msg.msg_iov->iov_len;
+      ++msg.msg_iov;
+      --msg.msg_iovlen;
+    }
+    if(msg.msg_iovlen > 0)
+    {
+      msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + n;
+      msg.msg_iov->iov_len -= n;
+    }
+  }
+  return true;
+}
+
+void benchConversion(Resolution res)
+{
+  const auto src = randomImage(res);
+  const std::size_t pixels = std::size_t(res.width) * res.height;
+  std::vector<uint8_t> dst(pixels * 3);
+  for(const auto& kernel : availableRgbaToRgbKernels())
+  {
+    measure("convert", kernel.name, res, src.size(), [&] {
+      kernel.convert(src.data(), dst.data(), pixels);
+    });
+  }
+
+  // Brightness, gamma and white balance in the same pass
+  const auto lut = ColorLut::make(0.8, 2.2, 1., 0.9, 0.7);
+  measure("convert", "lut", res, src.size(), [&] {
+    rgbaToRgbLut(src.data(), dst.data(), pixels, lut);
+  });
+}
+
+// Row-band conversion from 1 to N threads, N being the core count. Frames
+// below RowBandPool::minParallelPixels stay on one thread whatever the count.
+void benchBands(Resolution res)
+{
+  const auto src = randomImage(res);
+  std::vector<uint8_t> dst(std::size_t(res.width) * res.height * 3);
+  const int cores = std::max(1, int(std::thread::hardware_concurrency()));
+  for(int threads = 1; threads <= cores; threads++)
+  {
+    RowBandPool bands{threads};
+    const QString variant = QString{"threads=%1"}.arg(threads);
+    measure("bands", variant.toUtf8().constData(), res, src.size(), [&] {
+      bands.forEachBand(res.width, res.height, [&](int begin, int end) {
+        const std::size_t first = std::size_t(begin) * res.width;
+        rgbaToRgb(
+            src.data() + first * 4, dst.data() + first * 3,
+            std::size_t(end - begin) * res.width);
+      });
+    });
+  }
+}
+
+// A solid frame is the worst case, scanned to the end; varying content stops at the first block
+void benchUniform(Resolution res)
+{
+  const std::vector<uint8_t> solid(std::size_t(res.width) * res.height * 4, 0x40);
+  const auto varying = randomImage(res);
+  const std::size_t pixels = std::size_t(res.width) * res.height;
+  measure("uniform", "solid", res, solid.size(), [&] {
+    [[maybe_unused]] volatile bool r = uniformColor(solid.data(), pixels, 2).has_value();
+  });
+  measure("uniform", "varying", res, varying.size(), [&] {
+    [[maybe_unused]] volatile bool r = uniformColor(varying.data(), pixels, 2).has_value();
+  });
+}
+
+// Per-LED averages of a typical 40x22 ambilight layout, whose image is all that gets encoded
+void benchLeds(Resolution res)
+{
+  const auto src = randomImage(res);
+  OutputSettings settings;
+  settings.ledTop = settings.ledBottom = 40;
+  settings.ledLeft = settings.ledRight = 22;
+  LedSampler leds{settings};
+  measure("leds", "40x22", res, src.size(), [&] {
+    leds.sample(src.data(), res.width, res.height);
+  });
+}
+
+// "full" rebuilds the message every time, "patch" only rewrites the pixels of the previous one
+void benchEncode(Resolution res)
+{
+  const auto src = randomImage(res);
+  EncodedFrame frame;
+  measure("encode", "full", res, src.size(), [&] {
+    frame.imageLayout.reset();
+    encodeImage(frame, src.data(), res.width, res.height, -1);
+  });
+  measure("encode", "patch", res, src.size(), [&] {
+    encodeImage(frame, src.data(), res.width, res.height, -1);
+  });
+}
+
+// Regular and zero-copy sends on the same connection. The frame is never
+// modified, so it does not need to be held until completion here.
+void measureSend(const char* variant, int fd, Resolution res, const EncodedFrame& frame)
+{
+  const std::size_t bytes = frame.header.size() + frame.body().size();
+  measure("send", variant, res, bytes, [&] { sendFramed(fd, frame); });
+
+  ZeroCopyTracker zeroCopy;
+  if(!zeroCopy.enable(fd))
+    return;
+
+  const QString zcVariant = QString{variant} + "-zerocopy";
+  measure("send", zcVariant.toUtf8().constData(), res, bytes, [&] {
+    sendFramed(fd, frame, &zeroCopy);
+    zeroCopy.reap(fd);
+  });
+
+  // Completions report whether the kernel still had to copy, as on loopback
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  zeroCopy.reap(fd);
+  emit(
+      {{"benchmark", "zerocopy"},
+       {"variant", zcVariant},
+       {"width", res.width},
+       {"height", res.height},
+       {"zero_copied", qint64(zeroCopy.zeroCopied())},
+       {"copied", qint64(zeroCopy.copied())}});
+}
+
+void benchSend(Resolution res)
+{
+  const auto src = randomImage(res);
+  EncodedFrame frame;
+  encodeImage(frame, src.data(), res.width, res.height, -1);
+
+  for(auto transport : {Transport::Tcp, Transport::Unix})
+  {
+    DrainServer server{transport};
+    const int fd = server.connect();
+    if(fd < 0)
+      continue;
+
+    measureSend(transportName(transport), fd, res, frame);
+    ::close(fd);
+  }
+
+  // Zero-copy only pays off through a real NIC
+  if(!remoteHost.isEmpty())
+  {
+    const int fd = connectRemote();
+    if(fd < 0)
+      return;
+
+    measureSend("remote", fd, res, frame);
+    ::close(fd);
+  }
+}
+
+// The whole path: dedup check, encoding, mailbox handoff and the sender thread
+void benchPipeline(Resolution res)
+{
+  for(auto transport : {Transport::Tcp, Transport::Unix})
+  {
+    DrainServer server{transport};
+    OutputSettings settings;
+    settings.port = server.port();
+    settings.localSocket = QString::fromStdString(server.path());
+    settings.rate = 1000.;
+    settings.deduplicate = false;
+    settings.maxInFlight = 0;
+
+    auto src = randomImage(res);
+    HyperionConnection connection{settings};
+
+    const auto connectDeadline = clock_type::now() + std::chrono::seconds{2};
+    while(!connection.isConnected() && clock_type::now() < connectDeadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    if(!connection.isConnected())
+      continue;
+
+    // Post at up to 1 kHz for the measurement time, the sender takes what it can
+    const auto start = clock_type::now();
+    const auto end = start + std::max(minTime, std::chrono::milliseconds{500});
+    uint64_t posted = 0;
+    while(clock_type::now() < end)
+    {
+      src[0] = uint8_t(posted++);
+      connection.sendImage(src.data(), res.width, res.height, -1, clock_type::now());
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    const auto stats = connection.statistics();
+
+    emit(
+        {{"benchmark", "pipeline"},
+         {"variant", selectedRgbaToRgbKernel().name},
+         {"transport", transportName(transport)},
+         {"width", res.width},
+         {"height", res.height},
+         {"posted", qint64(posted)},
+         {"sent", qint64(stats.sent)},
+         {"superseded", qint64(stats.superseded)},
+         {"fps", double(stats.sent) / elapsed},
+         {"latency_ms", stats.latency}});
+  }
+}
+}
+
+int main(int argc, char** argv)
+{
+  QCoreApplication app{argc, argv};
+  QCoreApplication::setApplicationName("score_addon_hyperion_bench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Benchmarks the Hyperion output pipeline");
+  parser.addHelpOption();
+  QCommandLineOption minTimeOption{
+      "min-time", "Minimum measurement time per case, in ms", "ms", "200"};
+  QCommandLineOption filterOption{
+      "filter", "Only run the benchmarks whose name contains this", "name"};
+  QCommandLineOption outputOption{"output", "Write the results to this file", "file"};
+  QCommandLineOption remoteOption{
+      "remote", "Also benchmark sends to this server, e.g. a remote mock server", "host:port"};
+  parser.addOptions({minTimeOption, filterOption, outputOption, remoteOption});
+  parser.process(app);
+
+  minTime = std::chrono::milliseconds{parser.value(minTimeOption).toInt()};
+  const QString filter = parser.value(filterOption);
+  if(parser.isSet(remoteOption))
+  {
+    const QStringList remote = parser.value(remoteOption).split(':');
+    remoteHost = remote.value(0);
+    remotePort = remote.value(1, "19400").toInt();
+  }
+  if(parser.isSet(outputOption))
+  {
+    output = std::fopen(parser.value(outputOption).toLocal8Bit().constData(), "w");
+    if(!output)
+    {
+      std::perror("score_addon_hyperion_bench");
+      return 1;
+    }
+  }
+
+  QJsonObject info{
+      {"benchmark", "info"}, {"kernel", selectedRgbaToRgbKernel().name}};
+#if defined(__clang__)
+  info["compiler"] = "clang " __clang_version__;
+#elif defined(__GNUC__)
+  info["compiler"] = "gcc " __VERSION__;
+#endif
+  emit(info);
+
+  // A wrong kernel makes the numbers meaningless
+  if(!validateKernels() || !validateUniform())
+    return 1;
+  emit({{"benchmark", "validate"}, {"ok", true}});
+
+  const std::pair<const char*, void (*)(Resolution)> benchmarks[]{
+      {"convert", benchConversion},
+      {"bands", benchBands},
+      {"uniform", benchUniform},
+      {"leds", benchLeds},
+      {"encode", benchEncode},
+      {"send", benchSend},
+      {"pipeline", benchPipeline}};
+
+  for(const auto& [name, run] : benchmarks)
+  {
+    if(!filter.isEmpty() && !QString{name}.contains(filter))
+      continue;
+    for(auto res : resolutions)
+      run(res);
+  }
+
+  if(output != stdout)
+    std::fclose(output);
+  return 0;
+}
@@ -0,0 +1,268 @@
+// Load driver: runs many HyperionConnection instances at once, against the
+// in-process MockServer by default or an external server with --host.
+// Prints one JSON object per line every second, then per-connection and
+// aggregate summaries.
+
+#include "../mock/MockServer.hpp"
+
+#include <Hyperion/HyperionConnection.hpp>
+#include <Hyperion/Metrics.hpp>
+#include <Hyperion/OutputSettings.hpp>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace Hyperion;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+void emit(const QJsonObject& obj)
+{
+  std::printf("%s\n", QJsonDocument{obj}.toJson(QJsonDocument::Compact).constData());
+  std::fflush(stdout);
+}
+
+struct Client
+{
+  std::unique_ptr<HyperionConnection> connection;
+  std::vector<uint8_t> image;
+  bool connected{};
+  clock_type::time_point disconnectedAt{};
+  uint64_t connections{};
+  double reconnectTime{}; // Total time spent reconnecting, in s
+};
+}
+
+int main(int argc, char** argv)
+{
+  QCoreApplication app{argc, argv};
+  QCoreApplication::setApplicationName("score_addon_hyperion_load");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Runs many Hyperion connections against a server");
+  parser.addHelpOption();
+  QCommandLineOption connectionsOption{"connections", "Number of connections", "n", "24"};
+  QCommandLineOption durationOption{"duration", "Run time in seconds", "s", "10"};
+  QCommandLineOption widthOption{"width", "Image width", "px", "160"};
+  QCommandLineOption heightOption{"height", "Image height", "px", "90"};
+  QCommandLineOption rateOption{"rate", "Frames per second per connection", "fps", "60"};
+  QCommandLineOption sendRateOption{
+      "send-rate", "Frames sent per second per connection, 0 for the frame rate", "fps", "0"};
+  QCommandLineOption maxInFlightOption{
+      "max-in-flight", "Unacknowledged frames per connection, 0 for no limit", "n", "2"};
+  QCommandLineOption hostOption{"host", "External server, instead of the built-in mock", "host"};
+  QCommandLineOption portOption{"port", "Port of the external server", "port", "19400"};
+  QCommandLineOption socketOption{
+      "socket", "Built-in mock: listen on this Unix domain socket instead of TCP", "path"};
+  QCommandLineOption readRateOption{
+      "read-rate", "Built-in mock: per-client read limit in bytes/s", "bytes", "0"};
+  QCommandLineOption frameDelayOption{
+      "frame-delay", "Built-in mock: processing time of each image, in ms", "ms", "0"};
+  QCommandLineOption disconnectOption{
+      "disconnect-every", "Built-in mock: close clients after this many images", "count", "0"};
+  QCommandLineOption socketsOption{
+      "sockets",
+      "Built-in mock over TCP: outputs share this many sockets, 0 for one per connection. "
+      "They are spread over 127.0.0.1 to 127.0.0.n, each address being one shared socket",
+      "n", "0"};
+  QCommandLineOption captureOption{
+      "capture", "Record the stream of the first connection to this file", "file"};
+  parser.addOptions(
+      {connectionsOption, durationOption, widthOption, heightOption, rateOption, sendRateOption,
+       maxInFlightOption, hostOption, portOption, socketOption, readRateOption, frameDelayOption,
+       disconnectOption, socketsOption, captureOption});
+  parser.process(app);
+
+  const int count = parser.value(connectionsOption).toInt();
+  const int duration = parser.value(durationOption).toInt();
+  const int width = std::max(parser.value(widthOption).toInt(), 4);
+  const int height = std::max(parser.value(heightOption).toInt(), 3);
+  const double rate = parser.value(rateOption).toDouble();
+  int sockets = parser.value(socketsOption).toInt();
+  if(sockets <= 0 || sockets > count)
+    sockets = count;
+
+  std::optional<MockServer> server;
+  OutputSettings settings;
+  if(parser.isSet(hostOption))
+  {
+    settings.host = parser.value(hostOption);
+    settings.port = parser.value(portOption).toInt();
+  }
+  else
+  {
+    server.emplace(MockServer::Options{
+        .port = 0,
+        .localSocket = parser.value(socketOption).toStdString(),
+        .readRate = parser.value(readRateOption).toDouble(),
+        .frameDelay = std::chrono::milliseconds{parser.value(frameDelayOption).toInt()},
+        .disconnectEvery = parser.value(disconnectOption).toInt()});
+    if(!server->start())
+    {
+      std::perror("score_addon_hyperion_load: cannot start the mock server");
+      return 1;
+    }
+    settings.host = "127.0.0.1";
+    settings.port = server->port();
+    settings.localSocket = parser.value(socketOption);
+  }
+  settings.rate = rate;
+  settings.sendRate = parser.value(sendRateOption).toDouble();
+  settings.maxInFlight = parser.value(maxInFlightOption).toInt();
+  // Every frame is different anyway because of the timestamp
+  settings.deduplicate = false;
+
+  auto metrics = std::make_shared<Metrics>();
+  std::vector<Client> clients(count);
+  for(int i = 0; i < count; i++)
+  {
+    settings.origin = QString{"load-%1"}.arg(i);
+    settings.priority = 100 + i % 100;
+    // Outputs to the same address share their socket
+    if(server && settings.localSocket.isEmpty())
+      settings.host = QString{"127.0.0.%1"}.arg(1 + i % sockets);
+    settings.captureFile = i == 0 ? parser.value(captureOption) : QString{};
+    clients[i].connection = std::make_unique<HyperionConnection>(settings, metrics);
+    clients[i].image.resize(std::size_t(width) * height * 4, uint8_t(i));
+  }
+
+  const auto period = std::chrono::duration_cast<clock_type::duration>(
+      std::chrono::duration<double>{1. / std::max(rate, 1.)});
+  const auto start = clock_type::now();
+  const auto end = start + std::chrono::seconds{duration};
+  auto nextFrame = start;
+  auto nextReport = start + std::chrono::seconds{1};
+  ConnectionStatistics lastTotal{};
+
+  auto total = [&] {
+    ConnectionStatistics t{};
+    for(auto& c : clients)
+    {
+      const auto s = c.connection->statistics();
+      t.sent += s.sent;
+      t.dropped += s.dropped;
+      t.superseded += s.superseded;
+      t.acknowledged += s.acknowledged;
+      t.latency += s.latency / clients.size();
+    }
+    return t;
+  };
+
+  while(clock_type::now() < end)
+  {
+    std::this_thread::sleep_until(nextFrame);
+    nextFrame += period;
+
+    const auto now = clock_type::now();
+    for(auto& c : clients)
+    {
+      // Track the reconnections and how long they take
+      const bool connected = c.connection->isConnected();
+      if(connected && !c.connected)
+      {
+        if(c.connections > 0)
+          c.reconnectTime += std::chrono::duration<double>(now - c.disconnectedAt).count();
+        c.connections++;
+      }
+      else if(!connected && c.connected)
+      {
+        c.disconnectedAt = now;
+      }
+      c.connected = connected;
+
+      MockServer::markFrame(c.image.data(), now);
+      c.connection->sendImage(c.image.data(), width, height, -1, now);
+    }
+
+    if(now >= nextReport)
+    {
+      nextReport += std::chrono::seconds{1};
+      const auto t = total();
+      QJsonObject line{
+          {"time", std::chrono::duration<double>(now - start).count()},
+          {"fps", double(t.sent - lastTotal.sent)},
+          {"sent", qint64(t.sent)},
+          {"dropped", qint64(t.dropped)},
+          {"superseded", qint64(t.superseded)},
+          {"link_latency_ms", t.latency}};
+      if(settings.effectiveSendRate() < rate)
+      {
+        LatencyHistogram::Buckets jitter;
+        metrics->sendJitter.collect(jitter);
+        line["send_jitter_p50_ms"] = LatencyHistogram::percentile(jitter, 0.5);
+        line["send_jitter_p99_ms"] = LatencyHistogram::percentile(jitter, 0.99);
+      }
+      if(server)
+      {
+        LatencyHistogram::Buckets latency;
+        server->latency.collect(latency);
+        line["received"] = qint64(server->statistics().images);
+        line["latency_p50_ms"] = LatencyHistogram::percentile(latency, 0.5);
+        line["latency_p99_ms"] = LatencyHistogram::percentile(latency, 0.99);
+      }
+      emit(line);
+      lastTotal = t;
+    }
+  }
+
+  const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+  uint64_t reconnects = 0;
+  double reconnectTime = 0.;
+  for(int i = 0; i < count; i++)
+  {
+    auto& c = clients[i];
+    const auto s = c.connection->statistics();
+    // The first connection is not a reconnection
+    const uint64_t r = c.connections > 0 ? c.connections - 1 : 0;
+    reconnects += r;
+    reconnectTime += c.reconnectTime;
+    emit(
+        {{"connection", i},
+         {"sent", qint64(s.sent)},
+         {"dropped", qint64(s.dropped)},
+         {"superseded", qint64(s.superseded)},
+         {"acknowledged", qint64(s.acknowledged)},
+         {"fps", double(s.sent) / elapsed},
+         {"effective_rate", s.effectiveRate},
+         {"link_latency_ms", s.latency},
+         {"reconnects", qint64(r)}});
+  }
+
+  const auto t = total();
+  QJsonObject summary{
+      {"summary", true},
+      {"connections", count},
+      {"sockets", server && settings.localSocket.isEmpty() ? sockets : 1},
+      {"width", width},
+      {"height", height},
+      {"rate", rate},
+      {"send_rate", settings.effectiveSendRate()},
+      {"sent", qint64(t.sent)},
+      {"dropped", qint64(t.dropped)},
+      {"superseded", qint64(t.superseded)},
+      {"acknowledged", qint64(t.acknowledged)},
+      {"fps", double(t.sent) / elapsed},
+      {"reconnects", qint64(reconnects)},
+      {"mean_reconnect_ms", reconnects > 0 ? 1000. * reconnectTime / reconnects : 0.}};
+  clients.clear();
+
+  if(server)
+  {
+    server->stop();
+    const auto s = server->statistics();
+    summary["received"] = qint64(s.images);
+    summary["invalid"] = qint64(s.invalid);
+    summary["server_disconnects"] = qint64(s.disconnects);
+  }
+  emit(summary);
+  return 0;
+}
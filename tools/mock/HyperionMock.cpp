@@ -0,0 +1,110 @@
+// Stand-in Hyperion FlatBuffers server, see MockServer.
+// Prints its statistics as one JSON object per line every second.
+
+#include "MockServer.hpp"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+using namespace Hyperion;
+
+namespace
+{
+std::atomic_bool interrupted{};
+}
+
+int main(int argc, char** argv)
+{
+  QCoreApplication app{argc, argv};
+  QCoreApplication::setApplicationName("score_addon_hyperion_mock");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Mock Hyperion FlatBuffers server");
+  parser.addHelpOption();
+  QCommandLineOption portOption{"port", "Port to listen on", "port", "19400"};
+  QCommandLineOption socketOption{
+      "socket", "Listen on this Unix domain socket instead of the port", "path"};
+  QCommandLineOption readRateOption{
+      "read-rate", "Per-client read limit in bytes/s, 0 for none", "bytes", "0"};
+  QCommandLineOption frameDelayOption{
+      "frame-delay", "Processing time of each image, in ms", "ms", "0"};
+  QCommandLineOption disconnectOption{
+      "disconnect-every", "Close clients after this many images", "count", "0"};
+  QCommandLineOption noReplyOption{"no-reply", "Do not answer requests"};
+  QCommandLineOption recordOption{"record", "Write every frame arrival to this CSV file", "file"};
+  QCommandLineOption durationOption{
+      "duration", "Run time in seconds, 0 until interrupted", "s", "0"};
+  parser.addOptions(
+      {portOption, socketOption, readRateOption, frameDelayOption, disconnectOption, noReplyOption,
+       recordOption, durationOption});
+  parser.process(app);
+
+  MockServer::Options options{
+      .port = parser.value(portOption).toInt(),
+      .localSocket = parser.value(socketOption).toStdString(),
+      .readRate = parser.value(readRateOption).toDouble(),
+      .frameDelay = std::chrono::milliseconds{parser.value(frameDelayOption).toInt()},
+      .disconnectEvery = parser.value(disconnectOption).toInt(),
+      .reply = !parser.isSet(noReplyOption)};
+
+  if(parser.isSet(recordOption))
+  {
+    options.record = std::fopen(parser.value(recordOption).toLocal8Bit().constData(), "w");
+    if(!options.record)
+    {
+      std::perror("score_addon_hyperion_mock");
+      return 1;
+    }
+  }
+
+  MockServer server{options};
+  if(!server.start())
+  {
+    std::perror("score_addon_hyperion_mock: cannot listen");
+    return 1;
+  }
+
+  std::signal(SIGINT, [](int) { interrupted = true; });
+  std::signal(SIGTERM, [](int) { interrupted = true; });
+
+  const int duration = parser.value(durationOption).toInt();
+  uint64_t lastImages = 0;
+  uint64_t lastBytes = 0;
+  for(int t = 1; !interrupted && (duration <= 0 || t <= duration); t++)
+  {
+    std::this_thread::sleep_for(std::chrono::seconds{1});
+
+    const auto stats = server.statistics();
+    LatencyHistogram::Buckets latency;
+    server.latency.collect(latency);
+
+    const auto line = QJsonDocument{QJsonObject{
+        {"time", t},
+        {"clients", qint64(stats.accepted - stats.disconnects)},
+        {"accepted", qint64(stats.accepted)},
+        {"disconnects", qint64(stats.disconnects)},
+        {"images", qint64(stats.images)},
+        {"colors", qint64(stats.colors)},
+        {"invalid", qint64(stats.invalid)},
+        {"fps", double(stats.images - lastImages)},
+        {"bytes_per_second", double(stats.bytes - lastBytes)},
+        {"latency_p50_ms", LatencyHistogram::percentile(latency, 0.5)},
+        {"latency_p99_ms", LatencyHistogram::percentile(latency, 0.99)}}}.toJson(QJsonDocument::Compact);
+    std::printf("%s\n", line.constData());
+    std::fflush(stdout);
+
+    lastImages = stats.images;
+    lastBytes = stats.bytes;
+  }
+
+  server.stop();
+  if(options.record)
+    std::fclose(options.record);
+  return 0;
+}
@@ -0,0 +1,430 @@
+#include "MockServer.hpp"
+
+#include "hyperion_reply_generated.h"
+#include "hyperion_request_generated.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+namespace Hyperion
+{
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+constexpr uint8_t frameMarker[4]{'H', 'Y', 'P', 'L'};
+constexpr uint32_t maxRequestSize = 64 * 1024 * 1024;
+constexpr std::size_t readChunk = 256 * 1024;
+}
+
+struct MockServer::Client
+{
+  int fd{-1};
+  std::size_t index{};
+  std::vector<uint8_t> buffer;
+  std::size_t read{};
+  uint64_t images{};
+  clock::time_point busyUntil{};
+  clock::time_point lastRefill{};
+  double allowance{};
+};
+
+MockServer::MockServer(Options options)
+    : m_options{options}
+{
+}
+
+MockServer::~MockServer()
+{
+  stop();
+}
+
+bool MockServer::start()
+{
+  const bool local = !m_options.localSocket.empty();
+  m_listen = ::socket(local ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+  if(m_listen < 0)
+    return false;
+
+  if(local)
+  {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if(m_options.localSocket.size() >= sizeof(addr.sun_path))
+    {
+      ::close(m_listen);
+      m_listen = -1;
+      return false;
+    }
+    std::memcpy(
+        addr.sun_path, m_options.localSocket.c_str(), m_options.localSocket.size() + 1);
+
+    // A stale socket file from a previous run would make bind() fail
+    ::unlink(addr.sun_path);
+    if(::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+       || ::listen(m_listen, 64) < 0)
+    {
+      ::close(m_listen);
+      m_listen = -1;
+      return false;
+    }
+  }
+  else
+  {
+    int one = 1;
+    ::setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_options.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(::bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+       || ::listen(m_listen, 64) < 0)
+    {
+      ::close(m_listen);
+      m_listen = -1;
+      return false;
+    }
+
+    // Port 0 picks an ephemeral one
+    socklen_t len = sizeof(addr);
+    ::getsockname(m_listen, reinterpret_cast<sockaddr*>(&addr), &len);
+    m_port = ntohs(addr.sin_port);
+  }
+  ::fcntl(m_listen, F_SETFL, O_NONBLOCK);
+
+  if(::pipe(m_wakePipe) != 0)
+    return false;
+
+  if(m_options.record)
+    std::fprintf(
+        m_options.record, "client,image,arrival_us,latency_us,width,height,bytes\n");
+
+  m_thread = std::thread{[this] { run(); }};
+  return true;
+}
+
+void MockServer::stop()
+{
+  if(m_thread.joinable())
+  {
+    m_stopped = true;
+    const char c = 0;
+    [[maybe_unused]] auto res = ::write(m_wakePipe[1], &c, 1);
+    m_thread.join();
+  }
+
+  for(auto& client : m_clients)
+    ::close(client->fd);
+  m_clients.clear();
+
+  for(int* fd : {&m_listen, &m_wakePipe[0], &m_wakePipe[1]})
+  {
+    if(*fd >= 0)
+      ::close(*fd);
+    *fd = -1;
+  }
+
+  if(!m_options.localSocket.empty())
+    ::unlink(m_options.localSocket.c_str());
+}
+
+MockServer::Statistics MockServer::statistics() const
+{
+  std::lock_guard lock{m_statsMutex};
+  return m_stats;
+}
+
+void MockServer::markFrame(uint8_t* rgba, clock::time_point t) noexcept
+{
+  const uint64_t ns
+      = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+  for(int i = 0; i < 4; i++)
+    rgba[i * 4] = frameMarker[i];
+  for(int i = 0; i < 8; i++)
+    rgba[(4 + i) * 4] = uint8_t(ns >> (8 * i));
+}
+
+void MockServer::run()
+{
+  std::vector<pollfd> fds;
+  while(!m_stopped)
+  {
+    const auto now = clock::now();
+    auto timeout = std::chrono::milliseconds{100};
+
+    fds.clear();
+    fds.push_back({m_wakePipe[0], POLLIN, 0});
+    fds.push_back({m_listen, POLLIN, 0});
+    for(auto& client : m_clients)
+    {
+      // A busy or throttled client is left alone until it can consume again
+      short events = POLLIN;
+      if(now < client->busyUntil)
+      {
+        events = 0;
+        timeout = std::min(
+            timeout, std::chrono::ceil<std::chrono::milliseconds>(client->busyUntil - now));
+      }
+      else if(m_options.readRate > 0. && client->allowance < 1.)
+      {
+        events = 0;
+        timeout = std::min(timeout, std::chrono::milliseconds{1});
+      }
+      fds.push_back({client->fd, events, 0});
+    }
+
+    if(::poll(fds.data(), fds.size(), int(timeout.count())) < 0 && errno != EINTR)
+      break;
+
+    if(fds[1].revents & POLLIN)
+      accept();
+
+    // Clients accepted above are not in fds yet, they get polled on the next iteration
+    const auto after = clock::now();
+    for(std::size_t i = 2; i < fds.size(); i++)
+    {
+      auto& client = *m_clients[i - 2];
+      if(!readClient(client, after))
+        closeClient(client);
+    }
+
+    std::erase_if(m_clients, [](const auto& c) { return c->fd < 0; });
+  }
+}
+
+void MockServer::accept()
+{
+  for(;;)
+  {
+    const int fd = ::accept(m_listen, nullptr, nullptr);
+    if(fd < 0)
+      return;
+
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    client->lastRefill = clock::now();
+
+    std::lock_guard lock{m_statsMutex};
+    client->index = m_stats.clients.size();
+    m_stats.clients.emplace_back();
+    m_stats.accepted++;
+    m_clients.push_back(std::move(client));
+  }
+}
+
+bool MockServer::readClient(Client& client, clock::time_point now)
+{
+  // Process what is already buffered first, it may have been held back by a delay
+  auto parse = [&] {
+    while(now >= client.busyUntil && client.fd >= 0)
+    {
+      const std::size_t available = client.buffer.size() - client.read;
+      if(available < 4)
+        break;
+
+      const uint8_t* header = client.buffer.data() + client.read;
+      const uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16)
+                            | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+      if(size > maxRequestSize)
+        return false;
+      if(available < 4 + size)
+        break;
+
+      client.read += 4 + size;
+      if(!processRequest(client, header + 4, size))
+        return false;
+    }
+
+    client.buffer.erase(client.buffer.begin(), client.buffer.begin() + client.read);
+    client.read = 0;
+    return true;
+  };
+
+  if(!parse())
+    return false;
+  if(now < client.busyUntil)
+    return true;
+
+  std::size_t budget = readChunk;
+  if(m_options.readRate > 0.)
+  {
+    // Token bucket holding at most 100 ms worth of data
+    const double dt = std::chrono::duration<double>(now - client.lastRefill).count();
+    client.lastRefill = now;
+    client.allowance
+        = std::min(client.allowance + dt * m_options.readRate, m_options.readRate / 10.);
+    budget = std::min(budget, std::size_t(client.allowance));
+    if(budget == 0)
+      return true;
+  }
+
+  const std::size_t previous = client.buffer.size();
+  client.buffer.resize(previous + budget);
+  const ssize_t n = ::recv(client.fd, client.buffer.data() + previous, budget, 0);
+  if(n <= 0)
+  {
+    client.buffer.resize(previous);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      return true;
+    return false;
+  }
+  client.buffer.resize(previous + n);
+  if(m_options.readRate > 0.)
+    client.allowance -= double(n);
+
+  {
+    std::lock_guard lock{m_statsMutex};
+    m_stats.bytes += n;
+    m_stats.clients[client.index].bytes += n;
+  }
+
+  return parse();
+}
+
+bool MockServer::processRequest(Client& client, const uint8_t* body, uint32_t size)
+{
+  const auto now = clock::now();
+
+  flatbuffers::Verifier verifier{body, size};
+  if(!hyperionnet::VerifyRequestBuffer(verifier))
+  {
+    {
+      std::lock_guard lock{m_statsMutex};
+      m_stats.invalid++;
+      m_stats.clients[client.index].invalid++;
+    }
+    sendReply(client, "Invalid request", -1);
+    return true;
+  }
+
+  auto req = hyperionnet::GetRequest(body);
+  switch(req->command_type())
+  {
+    case hyperionnet::Command_Register: {
+      auto reg = req->command_as_Register();
+      {
+        std::lock_guard lock{m_statsMutex};
+        auto& stats = m_stats.clients[client.index];
+        stats.origin = reg->origin()->str();
+        stats.priority = reg->priority();
+      }
+      sendReply(client, nullptr, reg->priority());
+      return true;
+    }
+
+    case hyperionnet::Command_Image: {
+      auto raw = req->command_as_Image()->data_as_RawImage();
+      const auto* data = raw ? raw->data() : nullptr;
+      if(!data || raw->width() <= 0 || raw->height() <= 0
+         || data->size() != std::size_t(raw->width()) * raw->height() * 3)
+      {
+        {
+          std::lock_guard lock{m_statsMutex};
+          m_stats.invalid++;
+          m_stats.clients[client.index].invalid++;
+        }
+        sendReply(client, "Size mismatch", -1);
+        return true;
+      }
+
+      // Latency of frames marked by the load driver
+      int64_t latencyUs = -1;
+      const uint8_t* rgb = data->data();
+      if(data->size() >= 12 * 3 && rgb[0] == frameMarker[0] && rgb[3] == frameMarker[1]
+         && rgb[6] == frameMarker[2] && rgb[9] == frameMarker[3])
+      {
+        uint64_t ns = 0;
+        for(int i = 0; i < 8; i++)
+          ns |= uint64_t(rgb[(4 + i) * 3]) << (8 * i);
+        const auto sent = clock::time_point{std::chrono::nanoseconds{ns}};
+        latency.record(now - sent);
+        latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(now - sent).count();
+      }
+
+      client.images++;
+      {
+        std::lock_guard lock{m_statsMutex};
+        m_stats.images++;
+        m_stats.clients[client.index].images++;
+      }
+
+      if(m_options.record)
+      {
+        const auto arrival
+            = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+        std::fprintf(
+            m_options.record, "%zu,%llu,%lld,%lld,%d,%d,%u\n", client.index,
+            (unsigned long long)client.images, (long long)arrival.count(),
+            (long long)latencyUs, raw->width(), raw->height(), size);
+      }
+
+      sendReply(client, nullptr, -1);
+
+      if(m_options.frameDelay.count() > 0)
+        client.busyUntil = now + m_options.frameDelay;
+
+      if(m_options.disconnectEvery > 0
+         && client.images % uint64_t(m_options.disconnectEvery) == 0)
+        return false;
+      return true;
+    }
+
+    case hyperionnet::Command_Color: {
+      {
+        std::lock_guard lock{m_statsMutex};
+        m_stats.colors++;
+        m_stats.clients[client.index].colors++;
+      }
+      sendReply(client, nullptr, -1);
+      return true;
+    }
+
+    default:
+      sendReply(client, nullptr, -1);
+      return true;
+  }
+}
+
+void MockServer::sendReply(Client& client, const char* error, int registered)
+{
+  if(!m_options.reply)
+    return;
+
+  flatbuffers::FlatBufferBuilder b{64};
+  b.Finish(hyperionnet::CreateReplyDirect(b, error, -1, registered));
+
+  const uint32_t size = b.GetSize();
+  std::vector<uint8_t> msg(4 + size);
+  msg[0] = (size >> 24) & 0xFF;
+  msg[1] = (size >> 16) & 0xFF;
+  msg[2] = (size >> 8) & 0xFF;
+  msg[3] = size & 0xFF;
+  std::memcpy(msg.data() + 4, b.GetBufferPointer(), size);
+
+  // Replies are tiny, a client not reading them loses them
+  [[maybe_unused]] auto res = ::send(client.fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+}
+
+void MockServer::closeClient(Client& client)
+{
+  if(client.fd < 0)
+    return;
+
+  ::close(client.fd);
+  client.fd = -1;
+
+  std::lock_guard lock{m_statsMutex};
+  m_stats.disconnects++;
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <Hyperion/Metrics.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Hyperion
+{
+// Stand-in for Hyperion's FlatBuffers server: accepts any number of
+// clients, verifies every Request, answers it with a Reply and records
+// when each frame arrived. Slow consumers and disconnects can be simulated.
+class MockServer
+{
+public:
+  struct Options
+  {
+    int port{19400};
+    // Listen on this Unix domain socket path instead of the port when set
+    std::string localSocket;
+    // Per-client read throughput limit in bytes/s, 0 for none
+    double readRate{};
+    // Processing time of every image, the client is not read meanwhile
+    std::chrono::milliseconds frameDelay{};
+    // Close a client after this many images, 0 for never
+    int disconnectEvery{};
+    bool reply{true};
+    // Per-frame arrival log, CSV
+    FILE* record{};
+  };
+
+  struct ClientStatistics
+  {
+    std::string origin;
+    int priority{-1};
+    uint64_t images{};
+    uint64_t colors{};
+    uint64_t invalid{};
+    uint64_t bytes{};
+  };
+
+  struct Statistics
+  {
+    uint64_t accepted{};
+    // Connections closed, by either side
+    uint64_t disconnects{};
+    uint64_t images{};
+    // Color commands, sent instead of uniform images
+    uint64_t colors{};
+    uint64_t invalid{};
+    uint64_t bytes{};
+    std::vector<ClientStatistics> clients;
+  };
+
+  // A frame posted by a client carrying markFrame() is recognized by the
+  // server, which then records its render-to-arrival latency here.
+  LatencyHistogram latency;
+
+  explicit MockServer(Options options);
+  ~MockServer();
+
+  MockServer(const MockServer&) = delete;
+  MockServer& operator=(const MockServer&) = delete;
+
+  // Returns false if the port or socket path cannot be bound
+  bool start();
+  void stop();
+
+  int port() const noexcept { return m_port; }
+  Statistics statistics() const;
+
+  // Writes a marker and the current steady_clock time into the red channel
+  // of the first 12 pixels of an RGBA image (at least 12 pixels)
+  static void markFrame(uint8_t* rgba, std::chrono::steady_clock::time_point t) noexcept;
+
+private:
+  struct Client;
+
+  void run();
+  void accept();
+  bool readClient(Client& client, std::chrono::steady_clock::time_point now);
+  bool processRequest(Client& client, const uint8_t* body, uint32_t size);
+  void sendReply(Client& client, const char* error, int registered);
+  void closeClient(Client& client);
+
+  Options m_options;
+  int m_listen{-1};
+  int m_port{};
+  int m_wakePipe[2]{-1, -1};
+  std::atomic_bool m_stopped{};
+  std::thread m_thread;
+
+  std::vector<std::unique_ptr<Client>> m_clients;
+  mutable std::mutex m_statsMutex;
+  Statistics m_stats;
+};
+}
@@ -0,0 +1,255 @@
+// Replays a capture recorded by the output (see StreamCapture) to a Hyperion
+// instance or score_addon_hyperion_mock, at the original pace or as fast as
+// the server reads. Messages are sent straight from the file mapping.
+// Prints one JSON object per line every second, then a summary.
+
+#include <Hyperion/StreamCapture.hpp>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace Hyperion;
+using clock_type = std::chrono::steady_clock;
+
+namespace
+{
+void emit(const QJsonObject& obj)
+{
+  std::printf("%s\n", QJsonDocument{obj}.toJson(QJsonDocument::Compact).constData());
+  std::fflush(stdout);
+}
+
+int connectTo(const std::string& host, int port, const std::string& localSocket)
+{
+  sockaddr_storage storage{};
+  socklen_t len{};
+  if(!localSocket.empty())
+  {
+    auto& addr = reinterpret_cast<sockaddr_un&>(storage);
+    if(localSocket.size() >= sizeof(addr.sun_path))
+      return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, localSocket.c_str(), localSocket.size() + 1);
+    len = sizeof(addr);
+  }
+  else
+  {
+    auto& addr = reinterpret_cast<sockaddr_in&>(storage);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if(inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0)
+      return -1;
+    len = sizeof(addr);
+  }
+
+  const int fd = ::socket(storage.ss_family, SOCK_STREAM, 0);
+  if(fd < 0)
+    return -1;
+  if(::connect(fd, reinterpret_cast<sockaddr*>(&storage), len) != 0)
+  {
+    ::close(fd);
+    return -1;
+  }
+
+  if(localSocket.empty())
+  {
+    int flag = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+  return fd;
+}
+
+// The replies are not needed, but must be read for the server to keep going
+struct Replay
+{
+  int fd{-1};
+  uint64_t replyBytes{};
+
+  bool drain()
+  {
+    uint8_t buf[16384];
+    for(;;)
+    {
+      const ssize_t n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+      if(n > 0)
+      {
+        replyBytes += uint64_t(n);
+        continue;
+      }
+      if(n == 0)
+        return false;
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+  }
+
+  // Waits until the deadline, draining the replies meanwhile
+  bool waitUntil(clock_type::time_point deadline)
+  {
+    for(auto now = clock_type::now(); now < deadline; now = clock_type::now())
+    {
+      pollfd p{fd, POLLIN, 0};
+      const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+      if(::poll(&p, 1, int(remaining.count())) > 0 && !drain())
+        return false;
+    }
+    return true;
+  }
+
+  bool send(std::span<const uint8_t> message)
+  {
+    std::size_t offset = 0;
+    while(offset < message.size())
+    {
+      const ssize_t n = ::send(
+          fd, message.data() + offset, message.size() - offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if(n > 0)
+      {
+        offset += std::size_t(n);
+        continue;
+      }
+      if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        return false;
+
+      pollfd p{fd, POLLIN | POLLOUT, 0};
+      if(::poll(&p, 1, 5000) <= 0 || (p.revents & (POLLERR | POLLHUP)))
+        return false;
+      if((p.revents & POLLIN) && !drain())
+        return false;
+    }
+    return drain();
+  }
+};
+}
+
+int main(int argc, char** argv)
+{
+  QCoreApplication app{argc, argv};
+  QCoreApplication::setApplicationName("score_addon_hyperion_replay");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Replays a Hyperion stream capture");
+  parser.addHelpOption();
+  parser.addPositionalArgument("capture", "Capture file recorded by the output");
+  QCommandLineOption hostOption{"host", "Server address", "host", "127.0.0.1"};
+  QCommandLineOption portOption{"port", "Server port", "port", "19400"};
+  QCommandLineOption socketOption{
+      "socket", "Unix domain socket of the server, instead of host and port", "path"};
+  QCommandLineOption maxSpeedOption{
+      "max-speed", "Send as fast as the server reads instead of at the recorded pace"};
+  QCommandLineOption loopOption{"loop", "Number of times the capture is played", "n", "1"};
+  parser.addOptions({hostOption, portOption, socketOption, maxSpeedOption, loopOption});
+  parser.process(app);
+
+  if(parser.positionalArguments().size() != 1)
+    parser.showHelp(1);
+
+  CaptureReader capture;
+  const auto path = parser.positionalArguments().front().toLocal8Bit();
+  if(!capture.open(path.toStdString()))
+  {
+    std::fprintf(
+        stderr, "score_addon_hyperion_replay: cannot read %s: %s\n", path.constData(),
+        std::strerror(errno));
+    return 1;
+  }
+  if(capture.truncated())
+    std::fprintf(stderr, "score_addon_hyperion_replay: capture truncated, replaying the rest\n");
+
+  const auto& records = capture.records();
+  if(records.empty())
+  {
+    std::fprintf(stderr, "score_addon_hyperion_replay: empty capture\n");
+    return 1;
+  }
+
+  Replay replay;
+  replay.fd = connectTo(
+      parser.value(hostOption).toStdString(), parser.value(portOption).toInt(),
+      parser.value(socketOption).toStdString());
+  if(replay.fd < 0)
+  {
+    std::perror("score_addon_hyperion_replay: cannot connect");
+    return 1;
+  }
+
+  const bool maxSpeed = parser.isSet(maxSpeedOption);
+  const int loops = std::max(parser.value(loopOption).toInt(), 1);
+  const auto start = clock_type::now();
+  auto nextReport = start + std::chrono::seconds{1};
+  uint64_t sent = 0, bytes = 0, lastSent = 0, lastBytes = 0;
+  bool failed = false;
+
+  for(int loop = 0; loop < loops && !failed; loop++)
+  {
+    // Each pass keeps the recorded spacing, starting from the first message
+    const auto origin = clock_type::now() - std::chrono::duration_cast<clock_type::duration>(
+                                                records.front().time);
+    for(const auto& record : records)
+    {
+      if(!maxSpeed && !replay.waitUntil(origin + record.time))
+      {
+        failed = true;
+        break;
+      }
+      if(!replay.send(record.message))
+      {
+        failed = true;
+        break;
+      }
+      sent++;
+      bytes += record.message.size();
+
+      if(const auto now = clock_type::now(); now >= nextReport)
+      {
+        nextReport += std::chrono::seconds{1};
+        emit(
+            {{"time", std::chrono::duration<double>(now - start).count()},
+             {"messages_per_second", double(sent - lastSent)},
+             {"bytes_per_second", double(bytes - lastBytes)},
+             {"sent", qint64(sent)}});
+        lastSent = sent;
+        lastBytes = bytes;
+      }
+    }
+  }
+
+  if(failed)
+    std::fprintf(stderr, "score_addon_hyperion_replay: connection lost\n");
+
+  // Give the server a moment to answer the last messages
+  replay.waitUntil(clock_type::now() + std::chrono::milliseconds{200});
+  ::close(replay.fd);
+
+  const double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+  const double recorded
+      = std::chrono::duration<double>(records.back().time - records.front().time).count();
+  emit(
+      {{"summary", true},
+       {"records", qint64(records.size())},
+       {"recorded_seconds", recorded},
+       {"loops", loops},
+       {"max_speed", maxSpeed},
+       {"sent", qint64(sent)},
+       {"bytes", qint64(bytes)},
+       {"reply_bytes", qint64(replay.replyBytes)},
+       {"seconds", elapsed},
+       {"messages_per_second", elapsed > 0. ? sent / elapsed : 0.},
+       {"mb_per_s", elapsed > 0. ? bytes / elapsed / 1e6 : 0.}});
+  return failed ? 1 : 0;
+}